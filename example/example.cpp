@@ -41,9 +41,11 @@ int main(int argc, char ** argv) {
         kernel->poll();
     }
 
-    // Optionally you might wish to start the kernel thread
-    // in a different thread, and to run it's start() method
-    kernel->start();
+    // Optionally you might wish to let the kernel do it's I/O
+    // in a dedicated thread (pinned to Config::ioThreadCPU if set),
+    // and stop it when you are done.
+    kernel->startBackground();
+    kernel->stop();
 
     return 0;
 };
\ No newline at end of file
@@ -25,6 +25,13 @@
 
 	};
 
+	/**
+	 * Use the compact binary frames for the property values, unless
+	 * the browser can't decode them or the page URL has a 'json' query key
+	 */
+	MarbleBar.binary = (window.ArrayBuffer !== undefined) && (window.DataView !== undefined) &&
+					   !/[?&]json(=|&|$)/.test(window.location.search);
+
 	/**
 	 * Helper function to allocate new ID
 	 */
@@ -56,6 +63,61 @@
 		}
 	}
 
+	/**
+	 * Handle a binary frame (see binary_protocol.hpp for the layout)
+	 */
+	MarbleBar.prototype.__handleBinary = function( buffer ) {
+		var view = new DataView(buffer),
+			bytes = new Uint8Array(buffer),
+			pos = 0;
+
+		// Read an unsigned LEB128 varint
+		var varint = function() {
+			var value = 0, mul = 1, b;
+			do {
+				b = bytes[pos++];
+				value += (b & 0x7F) * mul;
+				mul *= 128;
+			} while (b & 0x80);
+			return value;
+		};
+
+		// Read a UTF-8 string
+		var utf8 = function(len) {
+			var chunk = bytes.subarray(pos, pos+len);
+			pos += len;
+			if (window.TextDecoder) return new TextDecoder('utf-8').decode(chunk);
+			var s = '';
+			for (var i=0; i<chunk.length; i++) s += String.fromCharCode(chunk[i]);
+			return decodeURIComponent(escape(s));
+		};
+
+		// Only property values are sent in binary
+		if (bytes[pos++] != 0x01) return;
+		var viewID = 'v' + varint(),
+			count = varint(),
+			props = [];
+
+		for (var i=0; i<count; i++) {
+			var prop = 'p' + varint(), value = null;
+			switch (bytes[pos++]) {
+				case 0x01: value = false; break;
+				case 0x02: value = true; break;
+				case 0x03: value = view.getInt32(pos, true); pos += 4; break;
+				case 0x04: value = view.getFloat32(pos, true); pos += 4; break;
+				case 0x05: value = view.getFloat64(pos, true); pos += 8; break;
+				case 0x06: value = utf8(varint()); break;
+				case 0x07: value = JSON.parse(utf8(varint())); break;
+			}
+			props.push({ 'prop': prop, 'value': value });
+		}
+
+		// Forward to user like a JSON frame
+		for (var i=0; i<this.actionHandlers.length; i++) {
+			this.actionHandlers[i]( 'view/propchange-batch', { 'id': viewID, 'props': props } );
+		}
+	}
+
 	/**
 	 * Send an event to server JSON frame
 	 */
@@ -185,6 +247,7 @@
 
 			// Open websocket
 			var socket = new WebSocket(WS_ENDPOINT);
+			socket.binaryType = 'arraybuffer';
 
 			// Safari bugfix: When everything else fails
 			var timedOut = false,
@@ -216,7 +279,11 @@
 				self.disconnect();
 			};
 			socket.onmessage = function(e) {
-				self.__handleData( e.data );
+				if (typeof(e.data) == 'string') {
+					self.__handleData( e.data );
+				} else {
+					self.__handleBinary( e.data );
+				}
 			};
 
 		} catch(e) {
@@ -333,24 +400,11 @@
 		}).bind(this));
 
 		// Create property groups and their properties
+		this.groupIndex = { };
 		for (var group in specs.properties) {
 			if (!specs.properties.hasOwnProperty(group)) continue;
 			var props = specs.properties[group],
-				p_id = MarbleBar.new_id(),
-				b_id = MarbleBar.new_id(),
-				panelDOM = $('<div class="panel panel-default" id="'+p_id+'"></div>').appendTo( this.bodyDOM ),
-				headDOM = $('<div class="panel-heading"></div>').appendTo(panelDOM),
-				headTitle = $('<h4 class="panel-title"></div>').appendTo(headDOM),
-				collapseBtn = $('<a role="button" data-toggle="collapse" data-parent="#'+p_id+'" href="#'+b_id+'" aria-expanded="true" aria-controls="'+b_id+'"></button>').text(group).appendTo(headTitle),
-				bodyDOM = $('<div id="'+b_id+'" class="panel-body"></div>').appendTo(panelDOM),
-				formDOM = $('<form class="form-horizontal"></form>').appendTo( bodyDOM );
-
-			// Delete head panel if missing
-			if (group == "") {
-				headDOM.remove();
-			} else {
-				bodyDOM.addClass("collapse");
-			}
+				formDOM = this.createGroup( group );
 
 			// Create properties
 			for (var i=0; i<props.length; i++) {
@@ -360,6 +414,33 @@
 
 	}
 
+	/**
+	 * Create a property group panel, or return the existing one
+	 */
+	View.prototype.createGroup = function( group ) {
+		if (this.groupIndex[group]) return this.groupIndex[group];
+
+		var p_id = MarbleBar.new_id(),
+			b_id = MarbleBar.new_id(),
+			panelDOM = $('<div class="panel panel-default" id="'+p_id+'"></div>').appendTo( this.bodyDOM ),
+			headDOM = $('<div class="panel-heading"></div>').appendTo(panelDOM),
+			headTitle = $('<h4 class="panel-title"></div>').appendTo(headDOM),
+			collapseBtn = $('<a role="button" data-toggle="collapse" data-parent="#'+p_id+'" href="#'+b_id+'" aria-expanded="true" aria-controls="'+b_id+'"></button>').text(group).appendTo(headTitle),
+			bodyDOM = $('<div id="'+b_id+'" class="panel-body"></div>').appendTo(panelDOM),
+			formDOM = $('<form class="form-horizontal"></form>').appendTo( bodyDOM );
+
+		// Delete head panel if missing
+		if (group == "") {
+			headDOM.remove();
+		} else {
+			bodyDOM.addClass("collapse");
+		}
+
+		// Store on index
+		this.groupIndex[group] = formDOM;
+		return formDOM;
+	}
+
 	/**
 	 * Add a property in the view
 	 */
@@ -376,7 +457,7 @@
 
 		// Widget template
 		var id = MarbleBar.new_id(),
-			h1 = $('<div class="form-group mb-property"></div>').appendTo( host )
+			h1 = $('<div class="form-group mb-property"></div>').appendTo( host ),
 			h2 = $('<label class="col-sm-2 control-label" for="'+id+'"></label>').text(specs['meta'].title || "").appendTo(h1),
 			widgetDOM = $('<div class="col-sm-10"></div>').appendTo(h1);
 
@@ -384,6 +465,8 @@
 		var widget = new widget_CLASS( widgetDOM, id );
 		widget.view = this;
 		widget.id = specs.id;
+		widget.rowDOM = h1;
+		widget.labelDOM = h2;
 
 		// Store on index
 		this.propertyIndex[ specs.id ] = widget;
@@ -401,6 +484,34 @@
 
 	}
 
+	/**
+	 * Remove a property from the view
+	 */
+	View.prototype.removeProperty = function( id ) {
+		var widget = this.propertyIndex[id];
+		if (!widget) return;
+
+		// Remove from the DOM and the index
+		widget.rowDOM.remove();
+		delete this.propertyIndex[id];
+		var i = this.properties.indexOf(widget);
+		if (i >= 0) this.properties.splice(i, 1);
+	}
+
+	/**
+	 * Apply new specifications to a property of the view
+	 */
+	View.prototype.updatePropertySpecs = function( specs ) {
+		var widget = this.propertyIndex[specs.id];
+		if (!widget) return;
+
+		// Update label and specifications
+		widget.labelDOM.text(specs['meta'].title || "");
+		try {
+			widget.updateSpecs( specs );
+		} catch (e) { }
+	}
+
 	/**
 	 * Add a property in the view
 	 */
@@ -413,6 +524,21 @@
 		} catch(e) { };
 	}
 
+	/**
+	 * Update many properties in the view at once
+	 */
+	View.prototype.updateProperties = function( props ) {
+		for (var i=0; i<props.length; i++) {
+			var widget = this.propertyIndex[props[i].prop];
+			if (!widget) continue;
+
+			// Apply value
+			try {
+				widget.update( props[i].value );
+			} catch(e) { };
+		}
+	}
+
 	/**
 	 * Erase view properties
 	 */
@@ -447,6 +573,17 @@
 				self.remView( data['id'] );
 			} else if (action == 'view/propchange') {
 				self.setViewProperty( data['id'], data['prop'], data['value'] );
+			} else if (action == 'view/propchange-batch') {
+				self.setViewProperties( data['id'], data['props'] );
+			} else if (action == 'property/add') {
+				var view = self.viewIndex[data['view']];
+				if (view) view.createProperty( data['specs'], view.createGroup( data['group'] ) );
+			} else if (action == 'property/remove') {
+				var view = self.viewIndex[data['view']];
+				if (view) view.removeProperty( data['prop'] );
+			} else if (action == 'property/meta') {
+				var view = self.viewIndex[data['view']];
+				if (view) view.updatePropertySpecs( data['specs'] );
 			}
 
 		});
@@ -498,13 +635,23 @@
 		} catch (e) { };
 	}
 
+	/**
+	 * Set many view property values at once
+	 */
+	MarbleGUI.prototype.setViewProperties = function( id, props ) {
+		// Make sure we have that view
+		if (!this.viewIndex[id]) return;
+		// Apply value changes
+		this.viewIndex[id].updateProperties( props );
+	}
+
 	/**
 	 * Initialize MarbleBar GUI
 	 */
 	MarbleGUI.prototype.initGUI = function() {
 
 		// Send a request to initialize the GUI
-		this.sendEvent("ui/init");
+		this.sendEvent("ui/init", { 'binary': MarbleBar.binary });
 
 	}
 
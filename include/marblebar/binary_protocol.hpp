@@ -0,0 +1,82 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#ifndef _MARBLEBAR_BINARY_PROTOCOL_HPP_
+#define _MARBLEBAR_BINARY_PROTOCOL_HPP_
+
+#include <json/json.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * The values of some properties of a view, by property ID
+	 */
+	typedef vector< pair< unsigned int, Json::Value > > PropertyValues;
+
+	/**
+	 * The compact binary encoding of the property values, sent in binary
+	 * websocket frames to the sessions that asked for it in ``ui/init``.
+	 *
+	 * A values frame is laid out as follows, with all the integers
+	 * being unsigned LEB128 varints and the fixed-size numbers being
+	 * little-endian:
+	 *
+	 *   u8      BIN_VALUES
+	 *   varint  view ID
+	 *   varint  number of values
+	 *   then for every value:
+	 *   varint  property ID
+	 *   u8      type tag, followed by the payload of the type
+	 */
+	class BinaryProtocol {
+	public:
+
+		/**
+		 * Frame types
+		 */
+		static const unsigned char 	BIN_VALUES	= 0x01;
+
+		/**
+		 * Value type tags
+		 */
+		static const unsigned char 	TAG_NULL 	= 0x00;	// No payload
+		static const unsigned char 	TAG_FALSE 	= 0x01;	// No payload
+		static const unsigned char 	TAG_TRUE 	= 0x02;	// No payload
+		static const unsigned char 	TAG_I32 	= 0x03;	// 4 bytes
+		static const unsigned char 	TAG_F32 	= 0x04;	// 4 bytes
+		static const unsigned char 	TAG_F64 	= 0x05;	// 8 bytes
+		static const unsigned char 	TAG_STRING 	= 0x06;	// varint length and UTF-8 bytes
+		static const unsigned char 	TAG_JSON 	= 0x07;	// varint length and JSON text
+
+		/**
+		 * Encode the property values of a view to a values frame
+		 */
+		static string 				encodeValues( unsigned int view, const PropertyValues & values );
+
+	};
+
+};
+
+#endif /* _MARBLEBAR_BINARY_PROTOCOL_HPP_ */
@@ -39,6 +39,15 @@ namespace mb {
 	inline ConfigPtr defaultConfig()
 		{ return std::make_shared<Config>(); };
 
+	/**
+	 * What to do when the egress queue of a slow session is full
+	 */
+	enum EgressPolicy {
+		EgressDropOldest,		// Drop the oldest queued frames
+		EgressConflate, 		// Replace queued property values with newer ones, then drop the oldest frames
+		EgressDisconnect 		// Disconnect the session
+	};
+
 	/**
 	 * Configuration class
 	 */
@@ -49,7 +58,10 @@ namespace mb {
 		 * Intiialize MarbleBar config
 		 */
 		Config()
-			: webserverPort( 15234 )
+			: webserverPort( 15234 ), webserverTransport( "auto" ), ioThreadCPU( -1 ),
+			  egressMaxFrames( 1024 ), egressMaxBytes( 16*1024*1024 ), egressPolicy( EgressConflate ),
+			  egressSocketBuffer( 256*1024 ), websocketDeflate( true ), websocketDeflateThreshold( 128 ),
+			  staticMaxAge( 0 ), updateInterval( 20 )
 		{ }
 
 		/**
@@ -62,6 +74,60 @@ namespace mb {
 		 */
 		int webserverPort;
 
+		/**
+		 * The socket backend of the webserver: "epoll" (linux only),
+		 * "mongoose", or "auto" to pick the best available
+		 */
+		string webserverTransport;
+
+		/**
+		 * The CPU core to pin the background I/O thread to,
+		 * or -1 to let the operating system decide
+		 */
+		int ioThreadCPU;
+
+		/**
+		 * The maximum number of frames and bytes waiting
+		 * in the egress queue of a session
+		 */
+		size_t egressMaxFrames;
+		size_t egressMaxBytes;
+
+		/**
+		 * What to do when the egress queue of a session is full
+		 */
+		EgressPolicy egressPolicy;
+
+		/**
+		 * Frames are kept in the egress queue while the socket has
+		 * more than this many bytes not yet sent
+		 */
+		size_t egressSocketBuffer;
+
+		/**
+		 * Compress the websocket messages with permessage-deflate, if
+		 * the browser and the transport support it. Messages smaller
+		 * than the threshold are sent uncompressed.
+		 */
+		bool websocketDeflate;
+		size_t websocketDeflateThreshold;
+
+		/**
+		 * How many seconds the browser can cache the embedded
+		 * resources without revalidating them, or 0 to always
+		 * revalidate them. HTML pages are always revalidated.
+		 * Their URLs are not versioned, so a browser may run
+		 * stale scripts for this long after an upgrade.
+		 */
+		int staticMaxAge;
+
+		/**
+		 * The minimum milliseconds between two flushes of the property
+		 * values. A change after a quiet period is sent right away, but
+		 * a property changed continuously is sent at most this often.
+		 */
+		int updateInterval;
+
 	};
 
 };
@@ -0,0 +1,74 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#ifndef _MARBLEBAR_EVENT_NAMES_HPP_
+#define _MARBLEBAR_EVENT_NAMES_HPP_
+
+#include <string>
+
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * The names of the events and of the session actions, interned to
+	 * small integers when a handler is registered, so the incoming
+	 * events can be routed with array lookups.
+	 */
+	class EventNames {
+	public:
+
+		/**
+		 * The events of the built-in widgets, always interned first
+		 */
+		static const unsigned int 	UPDATE 		= 0;
+		static const unsigned int 	CLICK 		= 1;
+		static const unsigned int 	MOUSEDOWN 	= 2;
+		static const unsigned int 	MOUSEUP 	= 3;
+
+		/**
+		 * The ID of a name that was never interned
+		 */
+		static const unsigned int 	UNKNOWN 	= 0xFFFFFFFF;
+
+		/**
+		 * Return the ID of a name, interning it if needed
+		 */
+		static unsigned int 		intern( const string & name );
+
+		/**
+		 * Return the ID of a name, or UNKNOWN if it was never
+		 * interned. The names from the browser are looked up with
+		 * this, without locking or copying, and they can't grow the table.
+		 */
+		static unsigned int 		find( const char * name, size_t length );
+		static unsigned int 		find( const string & name )
+			{ return find( name.c_str(), name.length() ); };
+
+		/**
+		 * Return the name of an ID
+		 */
+		static string 				name( unsigned int id );
+
+	};
+
+};
+
+#endif /* _MARBLEBAR_EVENT_NAMES_HPP_ */
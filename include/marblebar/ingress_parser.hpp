@@ -0,0 +1,91 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#ifndef _MARBLEBAR_INGRESS_PARSER_HPP_
+#define _MARBLEBAR_INGRESS_PARSER_HPP_
+
+#include <json/json.h>
+#include <string>
+
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * A ``property/event`` frame from the browser
+	 */
+	class PropertyEvent {
+	public:
+
+		/**
+		 * The ID of the frame, used for the responses
+		 */
+		string 						id;
+
+		/**
+		 * The IDs of the view and the property
+		 */
+		unsigned int 				view;
+		unsigned int 				prop;
+
+		/**
+		 * The name of the event, like ``update`` or ``click``
+		 */
+		string 						name;
+
+		/**
+		 * The interned ID of the event name (see EventNames)
+		 */
+		unsigned int 				nameID;
+
+		/**
+		 * The event data
+		 */
+		Json::Value 				data;
+
+	};
+
+	/**
+	 * A parser for the most frequent frames from the browser, that
+	 * scans the text in place without building the whole JSON document.
+	 *
+	 * Only the shape sent by marblebar.js is recognized:
+	 *
+	 *   {"type":"event","name":"property/event","id":"<id>","data":
+	 *     {"view":"v<N>","prop":"p<N>","name":"<event>","data":{...}}}
+	 *
+	 * with the keys in any order and the event data being an object of
+	 * numbers, strings, booleans or nulls. Everything else is left to
+	 * jsoncpp.
+	 */
+	class IngressParser {
+	public:
+
+		/**
+		 * Parse a ``property/event`` frame. Returns false if the frame
+		 * has any other shape, in which case ``event`` is unspecified.
+		 */
+		static bool 				parsePropertyEvent( const char * buf, size_t len, PropertyEvent & event );
+
+	};
+
+};
+
+#endif /* _MARBLEBAR_INGRESS_PARSER_HPP_ */
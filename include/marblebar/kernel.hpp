@@ -24,7 +24,11 @@
 #include <memory>
 #include <map>
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
 #include <marblebar/config.hpp>
+#include <marblebar/mpsc_queue.hpp>
 #include <marblebar/server/webserver.hpp>
 
 using namespace std;
@@ -78,8 +82,9 @@ namespace mb {
 		ViewPtr 					createView( const string & title = "" );
 
 		/**
-		 * Return view ptr
+		 * Return a view by it's ID, or by the string form of it's ID
 		 */
+		ViewPtr						getViewByID( unsigned int id );
 		ViewPtr						getViewByID( const string & id );
 
 		/**
@@ -87,6 +92,25 @@ namespace mb {
 		 */
 		void 						openGUI();
 
+		/**
+		 * Start a dedicated I/O thread that polls the kernel
+		 */
+		void 						startBackground();
+
+		/**
+		 * Stop the I/O loop, send the pending updates and
+		 * wait for the I/O thread (if any) to exit
+		 */
+		virtual void 				stop();
+
+		/**
+		 * Run a function in the thread that polls the kernel. This is the
+		 * way to make structural changes (views, properties, metadata) or
+		 * to change string properties from any other thread. The function
+		 * runs immediately if called from the polling thread.
+		 */
+		void 						post( std::function<void()> fn );
+
 		/**
 		 * Broadcast to all session the fact that a view is added
 		 */
@@ -103,26 +127,96 @@ namespace mb {
 		void 						broadcastViewUpdated( ViewPtr view );
 
 		/**
-		 * Broadcast to all session the fact that a view property is changed
+		 * Broadcast to all session the fact that a property is added in a view group
+		 */
+		void 						broadcastPropertyAdded( ViewPtr view, PropertyPtr property, const string & groupTitle );
+
+		/**
+		 * Broadcast to all session the fact that a property is removed from a view
+		 */
+		void 						broadcastPropertyRemoved( ViewPtr view, PropertyPtr property );
+
+		/**
+		 * Broadcast to all session the new specifications of a property
+		 */
+		void 						broadcastPropertyUpdated( ViewPtr view, PropertyPtr property );
+
+		/**
+		 * Broadcast to all session the fact that some view properties are changed
+		 */
+		void 						broadcastViewPropertiesUpdate( ViewPtr view, const vector< PropertyPtr > & properties, WebserverConnectionPtr ignore = WebserverConnectionPtr() );
+
+		/**
+		 * Add a session in the subscribers of a view, that receive it's property values
+		 */
+		void 						subscribeView( const ViewPtr & view, const SessionPtr & session );
+
+		/**
+		 * Remove a session from the subscribers of a view
 		 */
-		void 						broadcastViewPropertyUpdate( ViewPtr view, PropertyPtr property );
+		void 						unsubscribeView( const ViewPtr & view, const SessionPtr & session );
+
+		/**
+		 * Mark a property as dirty, to be sent to the sessions on the next poll.
+		 * This function can be called from any thread.
+		 */
+		void 						markPropertyAsDirty( const PropertyPtr & property );
+
+		/**
+		 * Hold the last ``update`` event of a property that coalesces them,
+		 * to be handled after the given window in milliseconds, or on the
+		 * next poll if it's 0 (only from the kernel thread)
+		 */
+		void 						scheduleUIUpdate( const PropertyPtr & property, int window );
+
+		/**
+		 * Handle the held ``update`` events, all of them or only the ones
+		 * whose window passed. Returns the milliseconds until the next
+		 * window passes, or -1 if none is left.
+		 */
+		int 						flushUIUpdates( bool all );
+
+		/**
+		 * Handle the held ``update`` event of a single property right away
+		 */
+		void 						flushUIUpdate( Property * property );
 
 	protected:
 
+		/**
+		 * Send the values of all the dirty properties to the sessions
+		 */
+		virtual int 				flushUpdates();
+
 		/**
 		 * Create a new instance of the WebserverConnection
 		 */
 		virtual WebserverConnectionPtr openConnection( const std::string& domain, const std::string uri );
 
 		/**
-		 * Get next view ID
+		 * Unsubscribe the session of a closed websocket
+		 */
+		virtual void 				handleClose( TransportConnection * conn );
+
+		/**
+		 * The body of the background I/O thread
+		 */
+		void 						runBackground();
+
+		/**
+		 * Keep a new view and attach it to the kernel
+		 */
+		void 						registerView( const ViewPtr & view );
+
+		/**
+		 * Add a property in the dirty set (only from the kernel thread)
 		 */
-		string 						getNextViewID();
+		void 						addDirtyProperty( const PropertyPtr & property, const WebserverConnectionPtr & origin );
 
 	public:
 
 		/**
-		 * Views registered in the kernel
+		 * Views registered in the kernel, indexed by their ID
 		 */
 		vector< ViewPtr >			views;
 
@@ -139,9 +233,63 @@ namespace mb {
 		map< string, string >		state;
 
 		/**
-		 * Last view id
+		 * The background I/O thread
+		 */
+		thread 						ioThread;
+
+		/**
+		 * Properties changed by other threads, waiting to be
+		 * picked up by the kernel thread
+		 */
+		MPSCQueue< PropertyPtr >	dirtyQueue;
+
+		/**
+		 * Flag if the kernel thread was woken up for the dirty queue,
+		 * so it's signalled only once until the queue is drained
+		 */
+		atomic< bool > 				dirtyQueueSignalled;
+
+		/**
+		 * The earliest time the property values can be flushed again
+		 */
+		chrono::steady_clock::time_point nextValuesFlush;
+
+		/**
+		 * Functions posted by other threads, waiting to
+		 * run in the kernel thread
+		 */
+		MPSCQueue< std::function<void()> > taskQueue;
+
+		/**
+		 * Properties with values waiting to be flushed
+		 */
+		vector< PropertyPtr >		dirtyProperties;
+
+		/**
+		 * The connection that made the last change of a dirty property,
+		 * used to avoid echoing the value back to the browser it came from
+		 */
+		map< Property*, WebserverConnectionPtr > dirtyOrigins;
+
+		/**
+		 * A held ``update`` event, with the session it came from
+		 */
+		struct PendingUIUpdate {
+			PropertyPtr 						property;
+			WebserverConnectionPtr 				origin;
+			chrono::steady_clock::time_point 	deadline;
+		};
+
+		/**
+		 * The properties with held ``update`` events
+		 */
+		vector< PendingUIUpdate > 	pendingUpdates;
+
+		/**
+		 * The sessions that have each view active, indexed by the view ID
+		 * (only accessed by the kernel thread)
 		 */
-		int 						lastViewID;
+		vector< vector< SessionPtr > > viewSubscribers;
 
 	};
 
@@ -0,0 +1,121 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#ifndef _MARBLEBAR_MPSC_QUEUE_HPP_
+#define _MARBLEBAR_MPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * Lock-free, unbounded, multiple-producer single-consumer queue.
+	 *
+	 * Any thread can push without taking a lock (a single atomic exchange),
+	 * but only one thread at a time may pop. This is the node-based queue
+	 * by Dmitry Vyukov: the consumer always owns a stub node, whose value
+	 * has already been popped.
+	 */
+	template<class T>
+	class MPSCQueue {
+	public:
+
+		/**
+		 * Create an empty queue
+		 */
+		MPSCQueue()
+		{
+			Node * stub = new Node();
+			head.store( stub );
+			tail = stub;
+		}
+
+		/**
+		 * Release all the nodes still in the queue
+		 */
+		~MPSCQueue()
+		{
+			T value;
+			while (pop(value)) { };
+			delete tail;
+		}
+
+		/**
+		 * Push an item in the queue, from any thread
+		 */
+		void 					push( T value )
+		{
+			Node * node = new Node( std::move(value) );
+			Node * prev = head.exchange( node, memory_order_acq_rel );
+			prev->next.store( node, memory_order_release );
+		}
+
+		/**
+		 * Pop an item from the queue, only from the consumer thread.
+		 * Returns false if the queue is empty.
+		 */
+		bool 					pop( T & value )
+		{
+			Node * next = tail->next.load( memory_order_acquire );
+			if (next == nullptr)
+				return false;
+
+			// The next node becomes the new stub
+			value = std::move( next->value );
+			delete tail;
+			tail = next;
+			return true;
+		}
+
+	private:
+
+		// Non-copyable
+		MPSCQueue( const MPSCQueue & ) = delete;
+		MPSCQueue & operator= ( const MPSCQueue & ) = delete;
+
+		/**
+		 * A queue node
+		 */
+		struct Node {
+			Node() : next(nullptr), value() { };
+			Node( T && value ) : next(nullptr), value( std::move(value) ) { };
+			atomic< Node* > 	next;
+			T 					value;
+		};
+
+		/**
+		 * The last pushed node, shared by the producers
+		 */
+		atomic< Node* > 		head;
+
+		/**
+		 * The stub node, owned by the consumer
+		 */
+		Node * 					tail;
+
+	};
+
+};
+
+
+#endif /* _MARBLEBAR_MPSC_QUEUE_HPP_ */
@@ -22,6 +22,7 @@
 #define _MARBLEBAR_PLATFORM_HPP_
 
 #include <marblebar/config.hpp>
+#include <thread>
 
 namespace mb {
 
@@ -30,6 +31,11 @@ namespace mb {
 	 */
 	void						openGUIURL( ConfigPtr config );
 
+	/**
+	 * Pin the calling thread to the specified CPU core
+	 */
+	bool						setThreadAffinity( int cpu );
+
 }
 
 
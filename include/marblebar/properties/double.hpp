@@ -24,6 +24,7 @@
 #include <json/json.h>
 #include <string>
 #include <memory>
+#include <atomic>
 
 using namespace std;
 
@@ -51,7 +52,7 @@ namespace mb {
 		/**
 		 * Overridable function to apply a property change to it's contents
 		 */
-		virtual void 		handleUIEvent( const string & event, const Json::Value & data );
+		virtual void 		handleUIEvent( unsigned int event, const Json::Value & data );
 
 		/**
 		 * Overridable function to render the property value to a JSON value
@@ -91,9 +92,9 @@ namespace mb {
 	private:
 
 		/**
-		 * The internal property
+		 * The internal property, atomic so it can be changed from any thread
 		 */
-		double 				value;
+		atomic<double>		value;
 
 	};
 
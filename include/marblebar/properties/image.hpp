@@ -51,7 +51,7 @@ namespace mb {
 		/**
 		 * Overridable function to apply a property change to it's contents
 		 */
-		virtual void 		handleUIEvent( const string & event, const Json::Value & data );
+		virtual void 		handleUIEvent( unsigned int event, const Json::Value & data );
 
 		/**
 		 * Overridable function to render the property value to a JSON value
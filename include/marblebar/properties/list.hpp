@@ -25,6 +25,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
 
 using namespace std;
 
@@ -52,7 +53,7 @@ namespace mb {
 		/**
 		 * Overridable function to apply a property change to it's contents
 		 */
-		virtual void 		handleUIEvent( const string & event, const Json::Value & data );
+		virtual void 		handleUIEvent( unsigned int event, const Json::Value & data );
 
 		/**
 		 * Overridable function to render the property value to a JSON value
@@ -91,9 +92,9 @@ namespace mb {
 	private:
 
 		/**
-		 * The internal property
+		 * The internal property, atomic so it can be changed from any thread
 		 */
-		int 							index;
+		atomic<int>						index;
 
 		/**
 		 * The list of options
@@ -26,7 +26,9 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <atomic>
 #include <functional>
+#include <marblebar/event_names.hpp>
 
 using namespace std;
 
@@ -40,6 +42,21 @@ namespace mb {
 	// Event handling function
 	typedef std::function<void ( const Json::Value & args )>	EventCallback;
 
+	/**
+	 * Apply a read-modify-write operation on an atomic value, without
+	 * losing the concurrent changes of other threads. Returns the value
+	 * that was written.
+	 */
+	template<class T, class F>
+	T atomicApply( atomic<T> & value, F op )
+	{
+		T current = value.load(), desired;
+		do {
+			desired = op( current );
+		} while (!value.compare_exchange_weak( current, desired ));
+		return desired;
+	}
+
 }
 
 // view.hpp depends on us, so we should define pointers first
@@ -61,7 +78,17 @@ namespace mb {
 		/**
 		 * Attach to a view
 		 */
-		void 					attach( const ViewPtr& view, const string & id );
+		void 					attach( const ViewPtr& view, unsigned int id );
+
+		/**
+		 * Detach from the view, after the property is removed
+		 */
+		void 					detach();
+
+		/**
+		 * Check if the property is still part of it's view
+		 */
+		bool 					isAttached() const;
 
 		/**
 		 * Mark property value as dirty
@@ -69,9 +96,16 @@ namespace mb {
 		void					markAsDirty();
 
 		/**
-		 * Receive a UI event
+		 * Receive a UI event, by the interned ID of it's name. If the
+		 * ``coalesce`` metadata is set, the ``update`` events are held
+		 * by the kernel and only the last one of a burst is handled.
 		 */
-		void 					receiveUIEvent( const string & event, const Json::Value & data );
+		void 					receiveUIEvent( unsigned int event, const Json::Value & data );
+
+		/**
+		 * Handle the ``update`` event held for coalescing, if any
+		 */
+		void 					flushUIUpdate();
 
 		/**
 		 * Update a metadata field
@@ -79,12 +113,22 @@ namespace mb {
 		PropertyPtr 			meta( const string & property, const Json::Value & value );
 
 		/**
-		 * Register an event handler
+		 * Register an event handler, by the name or the interned ID of the event
 		 */
 		PropertyPtr 			on( const string & event, EventCallback callback );
+		PropertyPtr 			on( unsigned int event, EventCallback callback );
+
+		/**
+		 * Overridable function to apply a property change to it's contents.
+		 * The event is the interned ID of it's name (see EventNames). By
+		 * default it calls the overload with the name of the event.
+		 */
+		virtual void 			handleUIEvent( unsigned int event, const Json::Value & data );
 
 		/**
-		 * Overridable function to apply a property change to it's contents
+		 * Overridable function to apply a property change to it's contents,
+		 * by the name of the event. Properties written before the events
+		 * were interned keep working, but the ID overload is faster.
 		 */
 		virtual void 			handleUIEvent( const string & event, const Json::Value & data ) { };
 
@@ -111,21 +155,57 @@ namespace mb {
 		Json::Value 	metadata;
 
 		/**
-		 * The view is ID
+		 * The ID of the property, which is it's index in the view properties
 		 */
-		string 			id;
+		unsigned int 	id;
+
+		/**
+		 * Flag if the property has changes waiting to be flushed
+		 * (only accessed by the kernel thread)
+		 */
+		bool 			dirty;
+
+		/**
+		 * Flag if the property is waiting in the kernel queue
+		 * (accessed by any thread)
+		 */
+		atomic<bool>	queued;
 
 	protected:
 
+		/**
+		 * Pass a UI event to the handler of the property and to the callbacks
+		 */
+		void 					dispatchUIEvent( unsigned int event, const Json::Value & data );
+
+		/**
+		 * Send the new specifications of the property to the
+		 * sessions, after a metadata or a structural change
+		 */
+		void 					specsChanged();
+
 		/**
 		 * Flag if this view is attached
 		 */
 		bool 			attached;
 
 		/**
-		 * List of event callbacks
+		 * The window in milliseconds for coalescing the ``update`` events,
+		 * 0 to coalesce them within a poll, or -1 to handle all of them
+		 */
+		int 			coalesceWindow;
+
+		/**
+		 * The last ``update`` event held for coalescing, and the
+		 * flag if there is one (only accessed by the kernel thread)
+		 */
+		Json::Value 	pendingUpdate;
+		bool 			updatePending;
+
+		/**
+		 * List of event callbacks, indexed by the interned event ID
 		 */
-		map< string, vector< EventCallback > > eventCallbacks;
+		vector< vector< EventCallback > > eventCallbacks;
 
 	};
 
@@ -47,8 +47,8 @@ namespace mb {
 				dynamic_pointer_cast<Property>( property )
 			);
 
-		// Attach to this
-		property->attach( view, view->getNextPropertyID() );
+		// Attach to the view
+		view->registerProperty( property, title );
 
 		// Pass-through
 		return property;
@@ -0,0 +1,68 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#pragma once
+#ifndef _MB_EMBEDDED_FILES_H_
+#define _MB_EMBEDDED_FILES_H_
+
+#include <stddef.h>
+#include <string>
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * A static resource embedded at build-time by mkdata.pl, with it's
+	 * precompressed variants. A variant is NULL if it would not be
+	 * smaller than the raw file. Every variant has it's own quoted
+	 * strong ETag, derived from a hash of the contents.
+	 */
+	struct EmbeddedFile {
+		const char *			name;
+		size_t 					nameLength;
+		const unsigned char *	data;
+		size_t 					size;
+		const char *			etag;
+		const unsigned char *	gzip;
+		size_t 					gzipSize;
+		const char *			gzipETag;
+		const unsigned char *	brotli;
+		size_t 					brotliSize;
+		const char *			brotliETag;
+	};
+
+	/**
+	 * Look up an embedded file by name, or return NULL if missing.
+	 * This function is generated at build-time and uses a hash
+	 * table, so the name does not need to be null-terminated.
+	 */
+	const EmbeddedFile * 		findEmbeddedFile( const char * name, size_t length );
+
+	/**
+	 * Look up an embedded file by name
+	 */
+	inline const EmbeddedFile * findEmbeddedFile( const string& name )
+	{
+		return findEmbeddedFile( name.c_str(), name.length() );
+	}
+
+};
+
+#endif /* _MB_EMBEDDED_FILES_H_ */
@@ -0,0 +1,184 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#pragma once
+#ifndef _MB_TRANSPORT_H_
+#define _MB_TRANSPORT_H_
+
+#include <marblebar/config.hpp>
+
+#include <sys/types.h>
+#include <string>
+#include <memory>
+using namespace std;
+
+namespace mb {
+
+	// Forward declarations
+	class Transport;
+	typedef std::shared_ptr<Transport> 	TransportPtr;
+	class TransportHandler;
+
+	/**
+	 * A socket of a transport, either serving plain HTTP requests or
+	 * upgraded to a websocket.
+	 */
+	class TransportConnection {
+	public:
+
+		/**
+		 * Initialize a transport connection
+		 */
+		TransportConnection() : handlerData(NULL) { };
+
+		/**
+		 * Virtual destructor
+		 */
+		virtual ~TransportConnection() { };
+
+		/**
+		 * Return the URI of the request (or of the websocket handshake)
+		 */
+		virtual const char *	getURI() = 0;
+
+		/**
+		 * Return the value of a request header, or NULL if missing
+		 */
+		virtual const char *	getHeader( const char * name ) = 0;
+
+		/**
+		 * Set the status code of the HTTP response
+		 */
+		virtual void 			sendStatus( int code ) = 0;
+
+		/**
+		 * Add a header to the HTTP response
+		 */
+		virtual void 			sendHeader( const char * name, const char * value ) = 0;
+
+		/**
+		 * Append data to the body of the HTTP response
+		 */
+		virtual void 			sendData( const char * data, size_t len ) = 0;
+
+		/**
+		 * Append a region of an open file to the body of the HTTP
+		 * response, after the data already sent. The transport takes
+		 * ownership of the file descriptor.
+		 */
+		virtual void 			sendFile( int fd, off_t offset, size_t len ) = 0;
+
+		/**
+		 * Send a websocket frame with the given opcode
+		 */
+		virtual void 			sendFrame( int opcode, const char * data, size_t len ) = 0;
+
+		/**
+		 * Close the socket after the pending data are sent
+		 */
+		virtual void 			close() = 0;
+
+		/**
+		 * Return the number of bytes accepted but not yet written to the socket
+		 */
+		virtual size_t 			getPendingBytes() = 0;
+
+	public:
+
+		/**
+		 * Data attached by the transport handler, like the
+		 * session of a websocket
+		 */
+		void * 					handlerData;
+
+	};
+
+	/**
+	 * Interface to receive the events of a transport
+	 */
+	class TransportHandler {
+	public:
+
+		/**
+		 * Virtual destructor
+		 */
+		virtual ~TransportHandler() { };
+
+		/**
+		 * Handle a plain HTTP request. The response is complete when
+		 * this function returns.
+		 */
+		virtual void 			handleRequest( TransportConnection * conn ) = 0;
+
+		/**
+		 * A websocket handshake is accepted. The request headers
+		 * are still available.
+		 */
+		virtual void 			handleWebsocketOpen( TransportConnection * conn ) = 0;
+
+		/**
+		 * Handle an incoming websocket frame. Return false to close
+		 * the connection.
+		 */
+		virtual bool 			handleWebsocketFrame( TransportConnection * conn, int opcode, const char * data, size_t len ) = 0;
+
+		/**
+		 * The socket of a websocket sent all of it's pending data
+		 */
+		virtual void 			handleWritable( TransportConnection * conn ) = 0;
+
+		/**
+		 * The connection is closed and is about to be released
+		 */
+		virtual void 			handleClose( TransportConnection * conn ) = 0;
+
+	};
+
+	/**
+	 * A transport provides the HTTP and websocket I/O for the Webserver
+	 */
+	class Transport {
+	public:
+
+		/**
+		 * Create the transport selected in the configuration
+		 */
+		static TransportPtr 	create( ConfigPtr config, TransportHandler * handler );
+
+		/**
+		 * Virtual destructor
+		 */
+		virtual ~Transport() { };
+
+		/**
+		 * Wait up to ``timeout`` milliseconds for socket events and handle them
+		 */
+		virtual void 			poll( int timeout ) = 0;
+
+		/**
+		 * Interrupt a waiting poll(). This function can be called from any thread.
+		 */
+		virtual void 			wakeup() = 0;
+
+	};
+
+};
+
+#endif /* _MB_TRANSPORT_H_ */
@@ -0,0 +1,278 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#pragma once
+#ifndef _MB_TRANSPORT_EPOLL_H_
+#define _MB_TRANSPORT_EPOLL_H_
+
+#ifdef __linux__
+
+#include <marblebar/config.hpp>
+#include <marblebar/server/transport.hpp>
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+using namespace std;
+
+// zlib stream, used for permessage-deflate
+struct z_stream_s;
+
+namespace mb {
+
+	// Forward declarations
+	class EpollTransport;
+
+	/**
+	 * A non-blocking socket of the epoll transport
+	 */
+	class EpollConnection : public TransportConnection {
+	public:
+
+		/**
+		 * Wrap an accepted socket
+		 */
+		EpollConnection( EpollTransport * transport, int fd );
+
+		/**
+		 * Release the compression streams and the file being sent
+		 */
+		virtual ~EpollConnection();
+
+		// TransportConnection implementation
+		virtual const char *	getURI();
+		virtual const char *	getHeader( const char * name );
+		virtual void 			sendStatus( int code );
+		virtual void 			sendHeader( const char * name, const char * value );
+		virtual void 			sendData( const char * data, size_t len );
+		virtual void 			sendFile( int fd, off_t offset, size_t len );
+		virtual void 			sendFrame( int opcode, const char * data, size_t len );
+		virtual void 			close();
+		virtual size_t 			getPendingBytes();
+
+	private:
+		friend class EpollTransport;
+
+		/**
+		 * Mark the socket as closed, to be released by the transport
+		 */
+		void 					markClosed();
+
+		/**
+		 * Read everything available on the socket
+		 */
+		void 					handleReadable();
+
+		/**
+		 * Write as much of the output buffer as the socket accepts
+		 */
+		void 					handleWritable();
+
+		/**
+		 * Close the file being sent, if any
+		 */
+		void 					closeFile();
+
+		/**
+		 * Parse and handle all the complete HTTP requests in the input buffer
+		 */
+		bool 					processHTTP();
+
+		/**
+		 * Parse and handle all the complete websocket frames in the input buffer
+		 */
+		bool 					processWebsocket();
+
+		/**
+		 * Upgrade the connection to a websocket
+		 */
+		void 					acceptWebsocket( const char * key );
+
+		/**
+		 * Negotiate permessage-deflate (RFC 7692) from the offered
+		 * extensions, and return the accepted response parameters
+		 * or an empty string
+		 */
+		string 					acceptDeflate( const char * extensions );
+
+		/**
+		 * Compress or decompress a message with the connection streams
+		 */
+		bool 					deflateMessage( const char * data, size_t len, string & out );
+		bool 					inflateMessage( const string & data, string & out );
+
+		/**
+		 * The transport we belong to
+		 */
+		EpollTransport *		transport;
+
+		/**
+		 * The socket file descriptor
+		 */
+		int 					fd;
+
+		/**
+		 * Flag if the connection is upgraded to a websocket
+		 */
+		bool 					websocket;
+
+		/**
+		 * Flag if the socket should be closed when the output is sent
+		 */
+		bool 					closing;
+
+		/**
+		 * Flag if the socket is closed and waits to be released
+		 */
+		bool 					closed;
+
+		/**
+		 * Incoming data not processed yet
+		 */
+		string 					input;
+
+		/**
+		 * Outgoing data not written yet, and how much of it is already written
+		 */
+		string 					output;
+		size_t 					outputOffset;
+
+		/**
+		 * The request URI and the request headers
+		 */
+		string 					uri;
+		vector< pair<string, string> > headers;
+
+		/**
+		 * The HTTP response under construction
+		 */
+		int 					responseStatus;
+		string 					responseHeaders;
+		string 					responseBody;
+
+		/**
+		 * The file being sent with sendfile() after the output buffer,
+		 * it's current offset and the bytes left. Further requests
+		 * wait until it is sent.
+		 */
+		int 					fileFD;
+		off_t 					fileOffset;
+		size_t 					fileRemaining;
+
+		/**
+		 * Opcode, payload and compression flag of a fragmented websocket message
+		 */
+		int 					fragmentOpcode;
+		string 					fragment;
+		bool 					fragmentCompressed;
+
+		/**
+		 * The permessage-deflate streams, if negotiated, and if the
+		 * compression context is reset after every message
+		 */
+		struct z_stream_s *		deflater;
+		struct z_stream_s *		inflater;
+		bool 					deflateNoContext;
+
+	};
+
+	/**
+	 * Native linux transport using edge-triggered epoll. Every poll costs
+	 * as much as the number of sockets with activity, not the number of
+	 * open sockets.
+	 */
+	class EpollTransport : public Transport {
+	public:
+
+		/**
+		 * Create the listening socket and the epoll instance
+		 */
+		EpollTransport( ConfigPtr config, TransportHandler * handler );
+
+		/**
+		 * Close all the sockets
+		 */
+		virtual ~EpollTransport();
+
+		// Transport implementation
+		virtual void 			poll( int timeout );
+		virtual void 			wakeup();
+
+	private:
+		friend class EpollConnection;
+
+		/**
+		 * Accept all the pending connections
+		 */
+		void 					acceptConnections();
+
+		/**
+		 * Ask epoll to report the listening socket again, if it still
+		 * has connections that could not be accepted
+		 */
+		void 					rearmListener();
+
+		/**
+		 * The handler of the transport events
+		 */
+		TransportHandler *		handler;
+
+		/**
+		 * Flag if permessage-deflate is offered, and the minimum
+		 * size of a message to be compressed
+		 */
+		bool 					deflateEnabled;
+		size_t 					deflateThreshold;
+
+		/**
+		 * The epoll instance, the listening socket and the wakeup eventfd
+		 */
+		int 					epollFD;
+		int 					listenFD;
+		int 					wakeupFD;
+
+		/**
+		 * A descriptor kept open in reserve, so a connection can still be
+		 * accepted (and closed) when the process runs out of descriptors
+		 */
+		int 					spareFD;
+
+		/**
+		 * Release all the connections marked as closed
+		 */
+		void 					releaseClosed();
+
+		/**
+		 * Connections marked as closed, waiting to be released
+		 */
+		vector< EpollConnection* > closedConnections;
+
+		/**
+		 * All the open connections
+		 */
+		unordered_set< EpollConnection* > openConnections;
+
+	};
+
+};
+
+#endif /* __linux__ */
+
+#endif /* _MB_TRANSPORT_EPOLL_H_ */
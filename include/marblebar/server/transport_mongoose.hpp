@@ -0,0 +1,136 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#pragma once
+#ifndef _MB_TRANSPORT_MONGOOSE_H_
+#define _MB_TRANSPORT_MONGOOSE_H_
+
+#include <mongoose.h>
+#include <marblebar/config.hpp>
+#include <marblebar/server/transport.hpp>
+
+using namespace std;
+
+namespace mb {
+
+	/**
+	 * A mongoose connection, exposed as a transport connection
+	 */
+	class MongooseConnection : public TransportConnection {
+	public:
+
+		/**
+		 * Wrap a mongoose connection
+		 */
+		MongooseConnection( struct mg_connection * conn ) : conn(conn), closing(false), dataSent(false), fileFD(-1), fileRemaining(0) { };
+
+		/**
+		 * Close the file still being sent, if any
+		 */
+		virtual ~MongooseConnection();
+
+		// TransportConnection implementation
+		virtual const char *	getURI();
+		virtual const char *	getHeader( const char * name );
+		virtual void 			sendStatus( int code );
+		virtual void 			sendHeader( const char * name, const char * value );
+		virtual void 			sendData( const char * data, size_t len );
+		virtual void 			sendFile( int fd, off_t offset, size_t len );
+		virtual void 			sendFrame( int opcode, const char * data, size_t len );
+		virtual void 			close();
+		virtual size_t 			getPendingBytes();
+
+		/**
+		 * Send the next part of the file of the response, keeping at most
+		 * a window of it in the mongoose buffer. Returns true when the
+		 * whole file was sent.
+		 */
+		bool 					sendFileChunks();
+
+		/**
+		 * The mongoose connection
+		 */
+		struct mg_connection *	conn;
+
+		/**
+		 * Flag if close() was requested
+		 */
+		bool 					closing;
+
+		/**
+		 * Flag if any response body was sent
+		 */
+		bool 					dataSent;
+
+		/**
+		 * The file of the response, and how many bytes of it are left
+		 */
+		int 					fileFD;
+		size_t 					fileRemaining;
+
+	};
+
+	/**
+	 * Transport based on the mongoose webserver
+	 */
+	class MongooseTransport : public Transport {
+	public:
+
+		/**
+		 * Create a mongoose server and setup listening port
+		 */
+		MongooseTransport( ConfigPtr config, TransportHandler * handler );
+
+		/**
+		 * Destroy the mongoose server
+		 */
+		virtual ~MongooseTransport();
+
+		// Transport implementation
+		virtual void 			poll( int timeout );
+		virtual void 			wakeup();
+
+	private:
+
+		/**
+		 * The handler of the transport events
+		 */
+		TransportHandler *		handler;
+
+		/**
+		 * The mongoose server instance
+		 */
+		mg_server*				server;
+
+		/**
+		 * Raw event handler
+		 */
+		static int ev_handler(struct mg_connection *conn, enum mg_event ev);
+
+		/**
+		 * Callback used only to interrupt the server poll
+		 */
+		static int wakeup_callback(struct mg_connection *conn, enum mg_event ev);
+
+	};
+
+};
+
+#endif /* _MB_TRANSPORT_MONGOOSE_H_ */
@@ -22,14 +22,17 @@
 #ifndef _MB_WEBSERVER_H_
 #define _MB_WEBSERVER_H_
 
-#include <mongoose.h>
 #include <marblebar/config.hpp>
+#include <marblebar/server/transport.hpp>
 #include <marblebar/server/webserver_connection.hpp>
 
 #include <string>
 #include <map>
+#include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <thread>
 using namespace std;
 
 namespace mb {
@@ -40,10 +43,34 @@ namespace mb {
 	typedef std::weak_ptr<Webserver> 	WebserverWeakPtr;
 
 	/**
-	 * This class encapsulates the Mongoose (webserver) instance and provides
+	 * How many times the egress policy fired
+	 */
+	class EgressStats {
+	public:
+		EgressStats() : droppedFrames(0), conflatedFrames(0), disconnects(0) { };
+
+		/**
+		 * Frames dropped because the egress queue was full
+		 */
+		unsigned long 			droppedFrames;
+
+		/**
+		 * Property values dropped because a newer value was queued
+		 */
+		unsigned long 			conflatedFrames;
+
+		/**
+		 * Sessions disconnected because they could not keep up
+		 */
+		unsigned long 			disconnects;
+
+	};
+
+	/**
+	 * This class encapsulates the webserver transport and provides
 	 * the core functionality for interfacing with javascript via JSON RPC.
 	 */
-	class Webserver {
+	class Webserver : public TransportHandler {
 	public:
 
 		/**
@@ -69,29 +96,114 @@ namespace mb {
 		 */
 		void start();
 
+		/**
+		 * Stop the loop started with ``start``, after the pending
+		 * updates are sent. This function can be called from any thread.
+		 */
+		virtual void stop();
+
 		/**
 		 * Check if there are live registered connections
 		 */
 		bool hasLiveConnections();
 
+		/**
+		 * Interrupt a poll() that waits for events, so pending updates
+		 * are sent right away. This function can be called from any thread.
+		 */
+		void wakeup();
+
+		/**
+		 * Return how many times the egress policy fired
+		 */
+		EgressStats getEgressStats() const;
+
 	public:
 
 		/**
-		 * Serve a static resource under the given URL
+		 * Serve a file from the disk under the given URL. The file is
+		 * opened on every request, and it is sent without reading it
+		 * in memory when the transport supports it.
 		 */
 		void serve_static( const string& url, const string& file );
 
+		/**
+		 * Apply the egress limits to a connection with pending egress
+		 * frames, and schedule it to be sent on the next poll
+		 */
+		void scheduleEgress( WebserverConnection * conn );
+
 	protected:
 
+		/**
+		 * Handle a plain HTTP request
+		 */
+		virtual void handleRequest( TransportConnection * conn );
+
+		/**
+		 * Open the session of a new websocket
+		 */
+		virtual void handleWebsocketOpen( TransportConnection * conn );
+
+		/**
+		 * Handle an incoming websocket frame
+		 */
+		virtual bool handleWebsocketFrame( TransportConnection * conn, int opcode, const char * data, size_t len );
+
+		/**
+		 * Send what is left in the egress queue of a drained websocket
+		 */
+		virtual void handleWritable( TransportConnection * conn );
+
+		/**
+		 * Release the session of a closed websocket
+		 */
+		virtual void handleClose( TransportConnection * conn );
+
+		/**
+		 * Send the egress queues of the scheduled connections
+		 */
+		void sendEgress();
+
 		/**
 		 * Create a new instance of the WebserverConnection
 		 */
 		virtual WebserverConnectionPtr openConnection( const string& domain, const string uri ) = 0;
 
 		/**
-		 * A list of active webserver connections
+		 * Overridable function called on every poll, before the egress
+		 * queues are sent to the sockets. Returns the milliseconds until
+		 * it must be called again, or -1 if it can wait for an event.
+		 */
+		virtual int flushUpdates() { return -1; };
+
+		/**
+		 * Check if the caller runs in the thread that polls the server
+		 */
+		bool isPollThread() const;
+
+		/**
+		 * Poll the server until ``stop`` is called and then flush
+		 * the pending updates
+		 */
+		void runLoop();
+
+		/**
+		 * Flag if the loop of ``start`` should keep running
+		 */
+		atomic< bool >									running;
+
+		/**
+		 * Flag if ``stop`` was called, so everything still held
+		 * back must be sent on the next poll
 		 */
-		map<mg_connection*, WebserverConnectionPtr>		connections;
+		atomic< bool >									stopping;
+
+		/**
+		 * A list of active webserver connections. Every connection knows
+		 * it's index, and it's socket points back to it.
+		 */
+		vector< WebserverConnectionPtr >				connections;
 
 		/**
 		 * The current connection under processing
@@ -111,29 +223,37 @@ namespace mb {
 		mutex 											connMutex;
 
 		/**
-		 * The mongoose server instance
+		 * The thread that last called poll()
 		 */
-		mg_server*										server;
+		atomic< thread::id >							pollThread;
 
 		/**
-		 * Map of static resources
+		 * Flag if a wakeup was requested since the last poll()
 		 */
-		map< string, string > 							staticResources;
+		atomic< bool >									wakeupPending;
 
 		/**
-		 * Iterator over the websocket connections
+		 * The connections with frames waiting to be sent
 		 */
-		static int 	iterate_callback(struct mg_connection *c, enum mg_event ev);
+		vector< WebserverConnection* >					egressPending;
 
 		/**
-		 * This is the entry point for the CernVM Web API I/O
+		 * The egress policy counters
 		 */
-		static int 	api_handler(struct mg_connection *conn);
+		atomic< unsigned long >							egressDropped;
+		atomic< unsigned long >							egressConflated;
+		atomic< unsigned long >							egressDisconnects;
 
 		/**
-		 * Raw event handler
+		 * The socket I/O backend
 		 */
-		static int ev_handler(struct mg_connection *conn, enum mg_event ev);
+		TransportPtr									transport;
+
+		/**
+		 * Map of static resources, and the mutex for accessing it
+		 */
+		map< string, string > 							staticResources;
+		mutex 											staticMutex;
 
 	};
 
@@ -22,14 +22,17 @@
 #ifndef _MB_WEBSERVER_CONNECTION_H_
 #define _MB_WEBSERVER_CONNECTION_H_
 
-#include <mongoose.h>
+#include <marblebar/server/transport.hpp>
+#include <marblebar/binary_protocol.hpp>
+#include <marblebar/ingress_parser.hpp>
 #include <json/json.h>
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <deque>
 using namespace std;
 
 namespace mb {
@@ -38,6 +41,85 @@ namespace mb {
 	class WebserverConnection;
 	typedef std::shared_ptr<WebserverConnection> 	WebserverConnectionPtr;
 	typedef std::weak_ptr<WebserverConnection> 		WebserverConnectionWeakPtr;
+	class EgressFrame;
+	typedef std::shared_ptr<const EgressFrame> 		EgressFramePtr;
+	class Webserver;
+
+	/**
+	 * An encoded frame, built once and shared between the egress
+	 * queues of all the connections it is sent to
+	 */
+	class EgressFrame {
+	public:
+
+		/**
+		 * Constructor
+		 */
+		EgressFrame( string data, unsigned int view = 0, PropertyValues values = PropertyValues(), string binary = "" ) 
+			: data( std::move(data) ), binary( std::move(binary) ), view( view ), values( std::move(values) ) { };
+
+		/**
+		 * The encoded frame contents
+		 */
+		const string 			data;
+
+		/**
+		 * The binary encoding of the frame, if it has one
+		 */
+		const string 			binary;
+
+		/**
+		 * For frames carrying property values, the view ID and the
+		 * values encoded in the frame (empty for the rest)
+		 */
+		const unsigned int 		view;
+		const PropertyValues 	values;
+
+	};
+
+	/**
+	 * An entry of the egress queue. It is either a shared frame, or
+	 * the values of some view properties that are encoded only when
+	 * they are sent, so newer values can replace them in place.
+	 */
+	class EgressEntry {
+	public:
+
+		/**
+		 * The shared frame, or empty for property values
+		 */
+		EgressFramePtr 			frame;
+
+		/**
+		 * The view ID and the property values
+		 */
+		unsigned int 			view;
+		PropertyValues 			values;
+
+		/**
+		 * The (estimated) size of the entry when encoded
+		 */
+		size_t 					bytes;
+
+	};
+
+	/**
+	 * The position of a queued property value
+	 */
+	class EgressSlot {
+	public:
+
+		/**
+		 * The sequence number of the egress entry
+		 */
+		unsigned long long 		entry;
+
+		/**
+		 * The index in the values of the entry
+		 */
+		size_t 					index;
+
+	};
 
 	/**
 	 * Abstract class for connection handlers
@@ -63,10 +145,15 @@ namespace mb {
 		 */
 		void 					sendRawData( const string& data );
 
+		/**
+		 * Send an already encoded frame
+		 */
+		void 					sendFrame( const EgressFramePtr& frame );
+
 		/**
 		 * Request to disconnect from the socket.
 		 */
-		void 					disconnect() { connected = false; };
+		void 					disconnect();
 
 		/**
 		 * Send a named action with arbitrary json data
@@ -78,6 +165,21 @@ namespace mb {
 		 */
 		virtual void			handleEvent( const string& id, const string& event, const Json::Value& data ) = 0;
 
+		/**
+		 * Handle incoming property events, parsed without jsoncpp
+		 */
+		virtual void			handlePropertyEvent( const PropertyEvent& event ) = 0;
+
+		/**
+		 * Encode a named action to a frame that can be sent to many connections
+		 */
+		static EgressFramePtr 	buildAction( const string& event, const Json::Value& data, const string& id = "" );
+
+		/**
+		 * Encode a named action to a string
+		 */
+		static string 			encodeAction( const string& event, const Json::Value& data, const string& id = "" );
+
 	///////////////////////////////////////////////////
 	// Low-level operations, used by the Webserver   //
 	///////////////////////////////////////////////////
@@ -107,17 +209,75 @@ namespace mb {
 
 		/**
 		 * Pops and returns the next frame from the egress queue, or returns
-		 * an empty string if there are no data in the egress queue.
+		 * an empty pointer if there are no data in the egress queue.
 		 */
-		string 					getEgressRawData();
+		EgressFramePtr 			getEgressFrame();
 
 		/**
-		 * Internal flag used to track lost connections
+		 * Check if there are frames waiting in the egress queue
 		 */
-		bool 					isIterated;
+		bool 					hasEgressFrames();
+
+		/**
+		 * Write the egress queue to the socket while it has less than
+		 * ``socketBuffer`` bytes pending, and close it if a disconnect
+		 * was requested
+		 */
+		void 					sendEgress( size_t socketBuffer );
+
+		/**
+		 * Check if the egress queue holds more than the given limits
+		 */
+		bool 					isEgressFull( size_t maxFrames, size_t maxBytes );
+
+		/**
+		 * Drop the oldest frames until the egress queue fits in the
+		 * given limits. Returns the number of dropped frames.
+		 */
+		size_t 					dropOldestFrames( size_t maxFrames, size_t maxBytes );
+
+		/**
+		 * Drop everything in the egress queue and disconnect
+		 */
+		void 					dropConnection();
+
+		/**
+		 * The webserver that schedules our egress queue
+		 */
+		Webserver *				server;
+
+		/**
+		 * The transport socket, or NULL when closed
+		 */
+		TransportConnection *	socket;
+
+		/**
+		 * Our index in the connections of the webserver
+		 */
+		size_t 					connIndex;
+
+		/**
+		 * Flag if we are scheduled in the webserver for sending
+		 */
+		bool 					egressScheduled;
+
+		/**
+		 * Flag if newer property values replace the queued ones
+		 */
+		bool 					conflate;
+
+		/**
+		 * The number of property values replaced since last checked
+		 */
+		size_t 					conflatedValues;
 
 	protected:
 
+		/**
+		 * Encode the values of some view properties to a frame
+		 */
+		virtual EgressFramePtr	encodeValues( unsigned int view, const PropertyValues& values ) = 0;
+
 		/**
 		 * The domain where the plugin resides
 		 */
@@ -129,15 +289,68 @@ namespace mb {
 		string 					uri;
 
 		/**
-		 * The egress queue
+		 * The last property event parsed, kept to reuse it's buffers
+		 */
+		PropertyEvent 			ingress;
+
+		/**
+		 * The egress queue, and the bytes it holds
 		 */
-		queue< string >			egress;
+		deque< EgressEntry >	egress;
+		size_t 					egressBytes;
+
+		/**
+		 * The sequence number of the first entry in the egress queue
+		 */
+		unsigned long long 		egressHead;
+
+		/**
+		 * The sequence number of the last structural frame, or
+		 * the maximum value if none was queued
+		 */
+		unsigned long long 		egressBarrier;
+
+		/**
+		 * The sequence number of the first entry whose shared frame
+		 * values are not yet in the index
+		 */
+		unsigned long long 		egressIndexed;
+
+		/**
+		 * The queued property values, by view ID (high 32 bits)
+		 * and property ID (low 32 bits)
+		 */
+		unordered_map< unsigned long long, EgressSlot > egressIndex;
 
 		/**
 		 * A status flag to let the server know when to drop the connection
 		 */
 		bool 					connected;
 
+		/**
+		 * Flag if the browser accepts binary frames
+		 */
+		bool 					binary;
+
+	private:
+
+		/**
+		 * Queue the values of a frame, replacing the queued values
+		 * of the same properties
+		 */
+		void 					queueValues( const EgressFramePtr& frame );
+
+		/**
+		 * Add the values of the shared frames still queued in the index,
+		 * so they can be replaced too
+		 */
+		void 					indexQueuedFrames();
+
+		/**
+		 * Remove the first entry of the egress queue
+		 */
+		EgressEntry 			popEgressEntry();
+
 	};
 
 };
@@ -22,6 +22,9 @@
 #define _MARBLEBAR_SESSION_HPP_
 
 #include <memory>
+#include <vector>
+#include <functional>
+#include <json/json.h>
 
 using namespace std;
 
@@ -31,6 +34,9 @@ namespace mb {
 	class Session;
 	typedef std::shared_ptr<Session> 	SessionPtr;
 	typedef std::weak_ptr<Session> 		SessionWeakPtr;
+
+	// Session action handling function
+	typedef std::function<void ( Session & session, const string & id, const Json::Value & data )>	SessionAction;
 }
 
 // kernel.hpp depends on us, so we should define pointers first
@@ -53,31 +59,88 @@ namespace mb {
 		 * Notify to session the fact that a view is added
 		 */
 		void 					notifyViewAdded( ViewPtr view );
+		void 					notifyViewAdded( ViewPtr view, const EgressFramePtr & frame );
 
 		/**
 		 * Notify to session the fact that a view is removed
 		 */
 		void 					notifyViewRemoved( ViewPtr view );
+		void 					notifyViewRemoved( ViewPtr view, const EgressFramePtr & frame );
 
 		/**
 		 * Notify to session the fact that a view is updated
 		 */
 		void 					notifyViewUpdated( ViewPtr view );
+		void 					notifyViewUpdated( ViewPtr view, const EgressFramePtr & frame );
+
+		/**
+		 * Notify to session a structural or metadata change of a view
+		 * property, using an encoded ``property/add``, ``property/remove``
+		 * or ``property/meta`` frame
+		 */
+		void 					notifyPropertyChanged( ViewPtr view, const EgressFramePtr & frame );
+
+		/**
+		 * Notify to session the fact that some view properties are changed
+		 */
+		void 					notifyViewPropertiesUpdate( ViewPtr view, const vector< PropertyPtr > & properties );
+		void 					notifyViewPropertiesUpdate( ViewPtr view, const EgressFramePtr & frame );
+
+		/**
+		 * Change the active view of the session, moving it
+		 * between the subscribers of the views
+		 */
+		void 					activateView( ViewPtr view );
+
+		/**
+		 * Register the handler of an action sent by the browser, replacing
+		 * any previous one. This should be done before any session is open.
+		 */
+		static void 			registerAction( const string & name, SessionAction action );
+
+		/**
+		 * Encode the values of some view properties to a frame that
+		 * can be sent to many sessions
+		 */
+		static EgressFramePtr 	buildValuesFrame( ViewPtr view, const vector< PropertyPtr > & properties );
 
 		/**
-		 * Notify to session the fact that a view property is changed
+		 * Build the JSON data of a ``view/propchange-batch`` action
 		 */
-		void 					notifyViewPropertyUpdate( ViewPtr view, PropertyPtr property );
+		static Json::Value 		buildValuesData( unsigned int view, const PropertyValues & values );
 
 	protected:
 
+		/**
+		 * Encode the property values merged in the egress queue
+		 */
+		virtual EgressFramePtr	encodeValues( unsigned int view, const PropertyValues& values );
+
 		/**
 		 * Javascript event handler
 		 */
 		virtual void 			handleEvent( const string& id, const string& event, const Json::Value& data );
 
+		/**
+		 * Property event handler
+		 */
+		virtual void 			handlePropertyEvent( const PropertyEvent& event );
+
 	private:
 
+		/**
+		 * The action handlers, indexed by the interned action name
+		 */
+		static vector< SessionAction > & actions();
+		static vector< SessionAction > builtinActions();
+
+		/**
+		 * Handlers of the built-in actions
+		 */
+		void 					handleInit( const string& id, const Json::Value& data );
+		void 					handleActivate( const string& id, const Json::Value& data );
+		void 					handlePropertyAction( const string& id, const Json::Value& data );
+
 		/**
 		 * Update view propeties
 		 */
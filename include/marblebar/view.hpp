@@ -23,6 +23,9 @@
 
 #include <memory>
 #include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
 #include <json/json.h>
 
 using namespace std;
@@ -34,6 +37,17 @@ namespace mb {
 	typedef std::shared_ptr<View> 	ViewPtr;
 	typedef std::weak_ptr<View> 	ViewWeakPtr;
 
+	/**
+	 * Format a view or property ID to it's string form in the
+	 * JSON messages, like 'v3' or 'p12'
+	 */
+	string 							formatUIID( char prefix, unsigned int id );
+
+	/**
+	 * Parse the string form of a view or property ID
+	 */
+	bool 							parseUIID( char prefix, const string & str, unsigned int & id );
+
 }
 
 // property.hpp & kernel.hpp depends on us, so we should define pointers first
@@ -57,7 +71,7 @@ namespace mb {
 		/**
 		 * Attach to a kernel
 		 */
-		void 						attach( const KernelPtr& kernel, const string & id );
+		void 						attach( const KernelPtr& kernel, unsigned int id );
 
 		/**
 		 * Create/Return a property group
@@ -80,10 +94,21 @@ namespace mb {
 		}
 
 		/**
-		 * Return a property by it's ID
+		 * Return a property by it's ID, or by the string form of it's ID
 		 */
+		PropertyPtr 				propertyById( unsigned int id );
 		PropertyPtr 				propertyById( const string& id );
 
+		/**
+		 * Attach a new property to the view and index it
+		 */
+		void 						registerProperty( const PropertyPtr& property, const string & groupTitle );
+
+		/**
+		 * Remove a property from the view. It's ID is not reused.
+		 */
+		void 						removeProperty( const PropertyPtr& property );
+
 		/**
 		 * Mark a particular property as dirty
 		 */
@@ -95,27 +120,46 @@ namespace mb {
 		Json::Value					getUISpecs();
 
 		/**
-		 * Update a metadata field
+		 * Return the ``view/add`` frame with the UI specifications, encoded
+		 * only once for every version of the view. The property values in it
+		 * are the ones at the time of encoding.
 		 */
-		ViewPtr 					meta( const string & property, const Json::Value & value );
+		EgressFramePtr				getSpecsFrame();
 
 		/**
-		 * Get next property ID
+		 * Mark the UI specifications as changed, after a structural
+		 * or a metadata change
 		 */
-		string 						getNextPropertyID();
+		void 						invalidateSpecs();
+
+		/**
+		 * Get the UI values of the specified view properties
+		 */
+		Json::Value					getUIValues( const vector< PropertyPtr > & properties );
+
+		/**
+		 * Update a metadata field
+		 */
+		ViewPtr 					meta( const string & property, const Json::Value & value );
 
 	public:
 
 		/**
-		 * The unique session ID for this instance
+		 * The unique ID of the view, which is it's index in the kernel views
 		 */
-		string 						id;
-		
+		unsigned int 				id;
+
 		/**
 		 * List of property groups
 		 */
 		map< string, PropertyGroupPtr >	propertyGroups;
 
+		/**
+		 * All the properties of the view, indexed by their ID. The
+		 * slots of the removed properties are left empty.
+		 */
+		vector< PropertyPtr > 		properties;
+
 		/**
 		 * Metatada information
 		 */
@@ -134,9 +178,17 @@ namespace mb {
 		bool 						attached;
 
 		/**
-		 * Last view id
+		 * The version of the UI specifications, and the version
+		 * of the cached ``view/add`` frame
+		 */
+		atomic< unsigned long > 	specsVersion;
+		unsigned long 				specsFrameVersion;
+
+		/**
+		 * The cached ``view/add`` frame, and the mutex for accessing it
 		 */
-		int 						lastPropertyID;
+		EgressFramePtr 				specsFrame;
+		mutex 						specsMutex;
 
 	};
 
@@ -0,0 +1,137 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#include "marblebar/binary_protocol.hpp"
+#include <stdint.h>
+#include <string.h>
+#include <limits>
+
+using namespace mb;
+
+/**
+ * Append an unsigned LEB128 varint
+ */
+static void put_varint( string & out, uint64_t value )
+{
+	while (value >= 0x80) {
+		out += (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	out += (char)value;
+}
+
+/**
+ * Append the little-endian bytes of a 32 or 64-bit number
+ */
+static void put_le( string & out, uint64_t value, int bytes )
+{
+	for (int i=0; i<bytes; ++i)
+		out += (char)((value >> (i*8)) & 0xFF);
+}
+
+/**
+ * Append a typed value
+ */
+static void put_value( string & out, const Json::Value & value )
+{
+	switch (value.type()) {
+
+		case Json::nullValue:
+			out += (char)BinaryProtocol::TAG_NULL;
+			break;
+
+		case Json::booleanValue:
+			out += (char)(value.asBool() ? BinaryProtocol::TAG_TRUE : BinaryProtocol::TAG_FALSE);
+			break;
+
+		case Json::intValue:
+			out += (char)BinaryProtocol::TAG_I32;
+			put_le( out, (uint32_t)(int32_t)value.asInt(), 4 );
+			break;
+
+		case Json::uintValue:
+			if (value.asUInt() <= (Json::UInt)numeric_limits<int32_t>::max()) {
+				out += (char)BinaryProtocol::TAG_I32;
+				put_le( out, (uint32_t)value.asUInt(), 4 );
+			} else {
+				double d = value.asDouble();
+				uint64_t bits; memcpy( &bits, &d, 8 );
+				out += (char)BinaryProtocol::TAG_F64;
+				put_le( out, bits, 8 );
+			}
+			break;
+
+		case Json::realValue: {
+			// Use single precision only when nothing is lost
+			double d = value.asDouble();
+			float f = (float)d;
+			if ((double)f == d) {
+				uint32_t bits; memcpy( &bits, &f, 4 );
+				out += (char)BinaryProtocol::TAG_F32;
+				put_le( out, bits, 4 );
+			} else {
+				uint64_t bits; memcpy( &bits, &d, 8 );
+				out += (char)BinaryProtocol::TAG_F64;
+				put_le( out, bits, 8 );
+			}
+			break;
+		}
+
+		case Json::stringValue: {
+			string str = value.asString();
+			out += (char)BinaryProtocol::TAG_STRING;
+			put_varint( out, str.length() );
+			out += str;
+			break;
+		}
+
+		default: {
+			// Arrays and objects travel as JSON text
+			Json::FastWriter writer;
+			string json = writer.write( value );
+			out += (char)BinaryProtocol::TAG_JSON;
+			put_varint( out, json.length() );
+			out += json;
+			break;
+		}
+
+	}
+}
+
+/**
+ * Encode the values of a view to a values frame
+ */
+string BinaryProtocol::encodeValues( unsigned int view, const PropertyValues & values )
+{
+	string out;
+
+	// Frame header
+	out += (char)BIN_VALUES;
+	put_varint( out, view );
+	put_varint( out, values.size() );
+
+	// The values
+	for (auto it = values.begin(); it != values.end(); ++it) {
+		put_varint( out, it->first );
+		put_value( out, it->second );
+	}
+
+	return out;
+}
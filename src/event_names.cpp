@@ -0,0 +1,195 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#include "marblebar/event_names.hpp"
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <mutex>
+
+using namespace mb;
+
+namespace {
+
+	/**
+	 * An interned name. The nodes are never changed or released
+	 * once published, so they can be read without locking.
+	 */
+	struct NameNode {
+		NameNode( const string & name, unsigned int id, unsigned int hash ) : name(name), id(id), hash(hash) { };
+		const string 			name;
+		const unsigned int 		id;
+		const unsigned int 		hash;
+	};
+
+	/**
+	 * An open-addressing hash table of the names, at most half full. New
+	 * names are published in an empty slot, so the readers see a slot
+	 * either empty or complete.
+	 */
+	struct NameIndex {
+		NameIndex( size_t size ) : mask(size - 1), slots(new atomic< NameNode* >[size])
+		{
+			for (size_t i=0; i<size; ++i)
+				slots[i].store( nullptr, memory_order_relaxed );
+		}
+
+		~NameIndex()
+			{ delete [] slots; };
+
+		void insert( NameNode * node )
+		{
+			size_t j = node->hash & mask;
+			while (slots[j].load( memory_order_relaxed ) != nullptr)
+				j = (j + 1) & mask;
+			slots[j].store( node, memory_order_release );
+		}
+
+		const size_t 			mask;
+		atomic< NameNode* > * 	slots;
+	};
+
+	/**
+	 * The 32-bit FNV-1a hash of a name
+	 */
+	unsigned int hashName( const char * name, size_t length )
+	{
+		unsigned int h = 2166136261u;
+		for (size_t i = 0; i < length; i++)
+			h = (h ^ (unsigned char)name[i]) * 16777619u;
+		return h;
+	}
+
+	/**
+	 * The interned names and the index the readers use. When the index
+	 * gets half full a twice as big copy replaces it; the old ones are
+	 * kept until exit, since a reader may still be probing them. The
+	 * mutex is only taken for adding names.
+	 */
+	struct NameTable {
+		NameTable() : index(nullptr), nodes(), indices(), mutex()
+		{
+			indices.push_back( new NameIndex(16) );
+			index.store( indices.back() );
+
+			// Keep the order of the EventNames constants
+			const char * builtin[] = { "update", "click", "mousedown", "mouseup" };
+			for (size_t i=0; i<sizeof(builtin)/sizeof(builtin[0]); ++i)
+				append( builtin[i] );
+		}
+
+		~NameTable()
+		{
+			for (auto it = indices.begin(); it != indices.end(); ++it)
+				delete *it;
+			for (auto it = nodes.begin(); it != nodes.end(); ++it)
+				delete *it;
+		}
+
+		/**
+		 * Publish a new name (with the mutex held)
+		 */
+		unsigned int append( const string & name )
+		{
+			NameNode * node = new NameNode( name, nodes.size(), hashName( name.c_str(), name.length() ) );
+			nodes.push_back( node );
+
+			// Grow the index before it gets more than half full
+			NameIndex * current = index.load( memory_order_relaxed );
+			if (nodes.size() * 2 > current->mask + 1) {
+				NameIndex * bigger = new NameIndex( (current->mask + 1) * 2 );
+				for (auto it = nodes.begin(); it != nodes.end(); ++it)
+					bigger->insert( *it );
+				indices.push_back( bigger );
+				index.store( bigger, memory_order_release );
+			} else {
+				current->insert( node );
+			}
+			return node->id;
+		}
+
+		/**
+		 * Look up a name without locking
+		 */
+		NameNode * lookup( const char * name, size_t length ) const
+		{
+			unsigned int hash = hashName( name, length );
+			const NameIndex * idx = index.load( memory_order_acquire );
+			for (size_t j = hash & idx->mask; ; j = (j + 1) & idx->mask) {
+				NameNode * node = idx->slots[j].load( memory_order_acquire );
+				if (node == nullptr)
+					return nullptr;
+				if ((node->hash == hash) && (node->name.length() == length) && (memcmp( node->name.data(), name, length ) == 0))
+					return node;
+			}
+		}
+
+		atomic< NameIndex* > 	index;
+		vector< NameNode* > 	nodes;
+		vector< NameIndex* > 	indices;
+		std::mutex 				mutex;
+	};
+
+	/**
+	 * Return the table, created on first use
+	 */
+	NameTable & table()
+	{
+		static NameTable instance;
+		return instance;
+	}
+
+}
+
+/**
+ * Return the ID of a name, interning it if needed
+ */
+unsigned int EventNames::intern( const string & name )
+{
+	NameTable & t = table();
+	std::unique_lock<std::mutex> lock(t.mutex);
+	NameNode * node = t.lookup( name.c_str(), name.length() );
+	if (node != nullptr)
+		return node->id;
+	return t.append( name );
+}
+
+/**
+ * Return the ID of a name, or UNKNOWN if it was never interned
+ */
+unsigned int EventNames::find( const char * name, size_t length )
+{
+	NameNode * node = table().lookup( name, length );
+	if (node == nullptr)
+		return UNKNOWN;
+	return node->id;
+}
+
+/**
+ * Return the name of an ID
+ */
+string EventNames::name( unsigned int id )
+{
+	NameTable & t = table();
+	std::unique_lock<std::mutex> lock(t.mutex);
+	if (id >= t.nodes.size())
+		return "";
+	return t.nodes[id]->name;
+}
@@ -0,0 +1,325 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#include "marblebar/ingress_parser.hpp"
+#include "marblebar/view.hpp"
+#include "marblebar/event_names.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+using namespace mb;
+
+/**
+ * A position in the text of a frame
+ */
+struct Cursor {
+	const char * p;
+	const char * end;
+};
+
+/**
+ * Skip the whitespace
+ */
+static void skip_space( Cursor & c )
+{
+	while ((c.p < c.end) && ((*c.p == ' ') || (*c.p == '\t') || (*c.p == '\n') || (*c.p == '\r')))
+		++c.p;
+}
+
+/**
+ * Skip the whitespace and the given character
+ */
+static bool expect( Cursor & c, char ch )
+{
+	skip_space( c );
+	if ((c.p >= c.end) || (*c.p != ch))
+		return false;
+	++c.p;
+	return true;
+}
+
+/**
+ * Skip a literal like ``true``
+ */
+static bool expect_literal( Cursor & c, const char * literal )
+{
+	size_t len = strlen( literal );
+	if (((size_t)(c.end - c.p) < len) || (memcmp( c.p, literal, len ) != 0))
+		return false;
+	c.p += len;
+	return true;
+}
+
+/**
+ * Skip the separator after an object member, and tell if more members follow
+ */
+static bool next_member( Cursor & c, bool & more )
+{
+	skip_space( c );
+	if (c.p >= c.end)
+		return false;
+	if (*c.p == ',') {
+		more = true;
+	} else if (*c.p == '}') {
+		more = false;
+	} else {
+		return false;
+	}
+	++c.p;
+	return true;
+}
+
+/**
+ * Parse a string, decoding the simple escapes. The unicode
+ * escapes are left to jsoncpp.
+ */
+static bool parse_string( Cursor & c, string & out )
+{
+	if (!expect( c, '"' ))
+		return false;
+	out.clear();
+	const char * start = c.p;
+	while (c.p < c.end) {
+		if (*c.p == '"') {
+			out.append( start, c.p - start );
+			++c.p;
+			return true;
+		} else if (*c.p == '\\') {
+			out.append( start, c.p - start );
+			if (++c.p >= c.end)
+				return false;
+			switch (*c.p) {
+				case '"': 	out += '"'; break;
+				case '\\': 	out += '\\'; break;
+				case '/': 	out += '/'; break;
+				case 'b': 	out += '\b'; break;
+				case 'f': 	out += '\f'; break;
+				case 'n': 	out += '\n'; break;
+				case 'r': 	out += '\r'; break;
+				case 't': 	out += '\t'; break;
+				default: 	return false;
+			}
+			start = ++c.p;
+		} else {
+			++c.p;
+		}
+	}
+	return false;
+}
+
+/**
+ * Parse a number, to the same value types as the jsoncpp reader
+ */
+static bool parse_number( Cursor & c, Json::Value & out )
+{
+	const char * start = c.p;
+	bool integer = true;
+	if ((c.p < c.end) && (*c.p == '-'))
+		++c.p;
+	while (c.p < c.end) {
+		char ch = *c.p;
+		if ((ch == '.') || (ch == 'e') || (ch == 'E') || (ch == '+') || (ch == '-')) {
+			integer = false;
+		} else if ((ch < '0') || (ch > '9')) {
+			break;
+		}
+		++c.p;
+	}
+
+	// Copy to a terminated buffer
+	char buf[32], * tail;
+	size_t len = c.p - start;
+	if ((len == 0) || (len >= sizeof(buf)))
+		return false;
+	memcpy( buf, start, len );
+	buf[len] = '\0';
+
+	// Integers that fit are kept as such, and the huge ones are
+	// left to jsoncpp
+	if (integer) {
+		if (len > 18)
+			return false;
+		long long value = strtoll( buf, &tail, 10 );
+		if (*tail != '\0')
+			return false;
+		if ((value >= INT_MIN) && (value <= INT_MAX)) {
+			out = Json::Value( (Json::Int)value );
+		} else if ((value > 0) && (value <= UINT_MAX)) {
+			out = Json::Value( (Json::UInt)value );
+		} else {
+			out = Json::Value( (double)value );
+		}
+	} else {
+		double value = strtod( buf, &tail );
+		if (*tail != '\0')
+			return false;
+		out = Json::Value( value );
+	}
+	return true;
+}
+
+/**
+ * Parse an object of numbers, strings, booleans or nulls
+ */
+static bool parse_flat_object( Cursor & c, Json::Value & out, string & key, string & str )
+{
+	out = Json::Value( Json::objectValue );
+	if (!expect( c, '{' ))
+		return false;
+
+	// Empty object
+	skip_space( c );
+	if ((c.p < c.end) && (*c.p == '}')) {
+		++c.p;
+		return true;
+	}
+
+	bool more = true;
+	while (more) {
+		if (!parse_string( c, key ) || !expect( c, ':' ))
+			return false;
+		skip_space( c );
+		if (c.p >= c.end)
+			return false;
+
+		// Nested objects and arrays are left to jsoncpp
+		Json::Value & value = out[key];
+		switch (*c.p) {
+			case '"':
+				if (!parse_string( c, str ))
+					return false;
+				value = str;
+				break;
+			case 't':
+				if (!expect_literal( c, "true" ))
+					return false;
+				value = true;
+				break;
+			case 'f':
+				if (!expect_literal( c, "false" ))
+					return false;
+				value = false;
+				break;
+			case 'n':
+				if (!expect_literal( c, "null" ))
+					return false;
+				break;
+			default:
+				if (!parse_number( c, value ))
+					return false;
+				break;
+		}
+
+		if (!next_member( c, more ))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Parse the data of a property event
+ */
+static bool parse_event_data( Cursor & c, PropertyEvent & event, string & key, string & str )
+{
+	if (!expect( c, '{' ))
+		return false;
+
+	int found = 0;
+	bool more = true;
+	while (more) {
+		if (!parse_string( c, key ) || !expect( c, ':' ))
+			return false;
+
+		if (key == "view") {
+			if (!parse_string( c, str ) || !parseUIID( 'v', str, event.view ))
+				return false;
+			found |= 1;
+		} else if (key == "prop") {
+			if (!parse_string( c, str ) || !parseUIID( 'p', str, event.prop ))
+				return false;
+			found |= 2;
+		} else if (key == "name") {
+			if (!parse_string( c, event.name ))
+				return false;
+			found |= 4;
+		} else if (key == "data") {
+			if (!parse_flat_object( c, event.data, key, str ))
+				return false;
+			found |= 8;
+		} else {
+			return false;
+		}
+
+		if (!next_member( c, more ))
+			return false;
+	}
+	return (found == 15);
+}
+
+/**
+ * Parse a property/event frame
+ */
+bool IngressParser::parsePropertyEvent( const char * buf, size_t len, PropertyEvent & event )
+{
+	Cursor c = { buf, buf + len };
+	string key, str;
+	if (!expect( c, '{' ))
+		return false;
+
+	int found = 0;
+	bool more = true;
+	while (more) {
+		if (!parse_string( c, key ) || !expect( c, ':' ))
+			return false;
+
+		if (key == "type") {
+			if (!parse_string( c, str ) || (str != "event"))
+				return false;
+			found |= 1;
+		} else if (key == "name") {
+			if (!parse_string( c, str ) || (str != "property/event"))
+				return false;
+			found |= 2;
+		} else if (key == "id") {
+			if (!parse_string( c, event.id ))
+				return false;
+			found |= 4;
+		} else if (key == "data") {
+			if (!parse_event_data( c, event, key, str ))
+				return false;
+			found |= 8;
+		} else {
+			return false;
+		}
+
+		if (!next_member( c, more ))
+			return false;
+	}
+
+	// Nothing else may follow
+	skip_space( c );
+	if ((found != 15) || (c.p != c.end))
+		return false;
+
+	// Intern the event name for the dispatch
+	event.nameID = EventNames::find( event.name );
+	return true;
+}
@@ -21,31 +21,39 @@
 #include "marblebar/kernel.hpp"
 #include "marblebar/session.hpp"
 #include "marblebar/platform.hpp"
-#include <sstream>
+
+#include <iostream>
 
 using namespace mb;
 
 /**
  * Marblebar kernel constructor
  */
-Kernel::Kernel( ConfigPtr config ) : Webserver(config), config(config), lastViewID(0)
+Kernel::Kernel( ConfigPtr config ) : Webserver(config), config(config), dirtyQueueSignalled(false), nextValuesFlush()
 { }
 
 /**
  * Marblebar kernel destructor
  */
 Kernel::~Kernel()
-{ }
+{
+	// Make sure the I/O thread is not running
+	if (ioThread.joinable()) {
+		if (ioThread.get_id() == this_thread::get_id()) {
+			ioThread.detach();
+		} else {
+			stop();
+		}
+	}
+}
 
 /**
  * Add a view in the marblebar kernel
  */
 KernelPtr Kernel::addView( ViewPtr view )
 {
-	// Keep view
-	views.push_back( view );
-	// Attach to the kernel
-	view->attach( shared_from_this(), getNextViewID() );
+	// Keep view and attach it to the kernel
+	registerView( view );
 	// Broadcast the fact that a view is added
 	this->broadcastViewAdded( view );
 
@@ -56,14 +64,32 @@ KernelPtr Kernel::addView( ViewPtr view )
 /**
  * Return view ptr
  */
+ViewPtr	Kernel::getViewByID( unsigned int id )
+{
+	if (id >= views.size())
+		return ViewPtr();
+	return views[id];
+}
+
+/**
+ * Return a view by the string form of it's ID
+ */
 ViewPtr	Kernel::getViewByID( const string & id )
 {
-	// Get view by ID
-	for (auto it = views.begin(); it != views.end(); ++it)
-		if ((*it)->id == id)
-			return (*it);
-	// Return empty view pointer
-	return ViewPtr();
+	unsigned int index;
+	if (!parseUIID( 'v', id, index ))
+		return ViewPtr();
+	return getViewByID( index );
+}
+
+/**
+ * Keep a new view, and attach it using it's index as ID
+ */
+void Kernel::registerView( const ViewPtr & view )
+{
+	views.push_back( view );
+	viewSubscribers.resize( views.size() );
+	view->attach( shared_from_this(), views.size() - 1 );
 }
 
 /**
@@ -74,10 +100,8 @@ ViewPtr Kernel::createView( const string & title )
 	// Create a shared view
 	ViewPtr view = make_shared<View>( title );
 
-	// Keep view
-	views.push_back( view );
-	// Attach to the kernel
-	view->attach( shared_from_this(), getNextViewID() );
+	// Keep view and attach it to the kernel
+	registerView( view );
 	// Broadcast the fact that a view is added
 	this->broadcastViewAdded( view );
 
@@ -94,6 +118,63 @@ void Kernel::openGUI( )
 	openGUIURL( config );
 }
 
+/**
+ * Start a dedicated I/O thread that polls the kernel
+ */
+void Kernel::startBackground()
+{
+	// Do not start twice
+	if (ioThread.joinable())
+		return;
+
+	// Start the loop in it's own thread. The flag is raised here
+	// so a stop() right after this call is not lost.
+	running = true;
+	stopping = false;
+	ioThread = thread( &Kernel::runBackground, this );
+}
+
+/**
+ * Pin the I/O thread to the configured core and poll the kernel
+ */
+void Kernel::runBackground()
+{
+	// The thread still runs if it can't be pinned, just not where requested
+	if ((config->ioThreadCPU >= 0) && !setThreadAffinity( config->ioThreadCPU ))
+		cerr << "marblebar: could not pin the I/O thread to CPU " << config->ioThreadCPU << endl;
+
+	runLoop();
+}
+
+/**
+ * Run a function in the thread that polls the kernel
+ */
+void Kernel::post( std::function<void()> fn )
+{
+	// Already in the kernel thread, no need to wait
+	if (isPollThread()) {
+		fn();
+		return;
+	}
+
+	// Otherwise hand it over through the lock-free queue
+	taskQueue.push( std::move(fn) );
+	wakeup();
+}
+
+/**
+ * Stop the I/O loop and wait for the I/O thread to exit
+ */
+void Kernel::stop()
+{
+	// Stop the loop
+	Webserver::stop();
+
+	// Wait for the I/O thread to flush and exit
+	if (ioThread.joinable() && (ioThread.get_id() != this_thread::get_id()))
+		ioThread.join();
+}
+
 /**
  * Broadcast to all session the fact that a view is added
  */
@@ -104,10 +185,19 @@ void Kernel::broadcastViewAdded( ViewPtr view )
 	if (activeConnection)
 		ignore = dynamic_pointer_cast<Session>(activeConnection);
 
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
+
+	// Encode the frame only once
+	EgressFramePtr frame = view->getSpecsFrame();
+
 	// Forward to all connections
 	for (auto it = connections.begin(); it != connections.end(); ++it)
-		if ((*it).second != ignore)
-			(dynamic_pointer_cast<Session>((*it).second))->notifyViewAdded( view );
+		if (*it != ignore)
+			(static_pointer_cast<Session>(*it))->notifyViewAdded( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
 }
 
 /**
@@ -120,10 +210,21 @@ void Kernel::broadcastViewRemoved( ViewPtr view )
 	if (activeConnection)
 		ignore = dynamic_pointer_cast<Session>(activeConnection);
 
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
+
+	// Encode the frame only once
+	Json::Value data;
+	data["id"] = formatUIID( 'v', view->id );
+	EgressFramePtr frame = WebserverConnection::buildAction( "view/remove", data );
+
 	// Forward to all connections
 	for (auto it = connections.begin(); it != connections.end(); ++it)
-		if ((*it).second != ignore)
-			(dynamic_pointer_cast<Session>((*it).second))->notifyViewRemoved( view );
+		if (*it != ignore)
+			(static_pointer_cast<Session>(*it))->notifyViewRemoved( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
 }
 
 /**
@@ -136,26 +237,341 @@ void Kernel::broadcastViewUpdated( ViewPtr view )
 	if (activeConnection)
 		ignore = dynamic_pointer_cast<Session>(activeConnection);
 
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
+
+	// Encode the frame only once
+	EgressFramePtr frame = WebserverConnection::buildAction( "view/update", view->getUISpecs() );
+
 	// Forward to all connections
 	for (auto it = connections.begin(); it != connections.end(); ++it)
-		if ((*it).second != ignore)
-			(dynamic_pointer_cast<Session>((*it).second))->notifyViewUpdated( view );
+		if (*it != ignore)
+			(static_pointer_cast<Session>(*it))->notifyViewUpdated( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
 }
 
 /**
- * Broadcast to all session the fact that a view property is changed
+ * Broadcast to all session the fact that a property is added in a view group
  */
-void Kernel::broadcastViewPropertyUpdate( ViewPtr view, PropertyPtr property )
+void Kernel::broadcastPropertyAdded( ViewPtr view, PropertyPtr property, const string & groupTitle )
 {
-	// Ignore broadcasts originating from the current session
-	SessionPtr ignore;
-	if (activeConnection)
-		ignore = dynamic_pointer_cast<Session>(activeConnection);
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
 
-	// Forward to all connections
+	// Encode the frame only once
+	Json::Value data;
+	data["view"] = formatUIID( 'v', view->id );
+	data["group"] = groupTitle;
+	data["specs"] = property->getUISpecs();
+	EgressFramePtr frame = WebserverConnection::buildAction( "property/add", data );
+
+	// Forward to all connections, including the one that caused it
 	for (auto it = connections.begin(); it != connections.end(); ++it)
-		if ((*it).second != ignore)
-			(dynamic_pointer_cast<Session>((*it).second))->notifyViewPropertyUpdate( view, property );
+		(static_pointer_cast<Session>(*it))->notifyPropertyChanged( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
+}
+
+/**
+ * Broadcast to all session the fact that a property is removed from a view
+ */
+void Kernel::broadcastPropertyRemoved( ViewPtr view, PropertyPtr property )
+{
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
+
+	// Encode the frame only once
+	Json::Value data;
+	data["view"] = formatUIID( 'v', view->id );
+	data["prop"] = formatUIID( 'p', property->id );
+	EgressFramePtr frame = WebserverConnection::buildAction( "property/remove", data );
+
+	// Forward to all connections, including the one that caused it
+	for (auto it = connections.begin(); it != connections.end(); ++it)
+		(static_pointer_cast<Session>(*it))->notifyPropertyChanged( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
+}
+
+/**
+ * Broadcast to all session the new specifications of a property
+ */
+void Kernel::broadcastPropertyUpdated( ViewPtr view, PropertyPtr property )
+{
+	// Do not encode anything if nobody is listening
+	if (connections.empty()) return;
+
+	// Encode the frame only once
+	Json::Value data;
+	data["view"] = formatUIID( 'v', view->id );
+	data["specs"] = property->getUISpecs();
+	EgressFramePtr frame = WebserverConnection::buildAction( "property/meta", data );
+
+	// Forward to all connections, including the one that caused it
+	for (auto it = connections.begin(); it != connections.end(); ++it)
+		(static_pointer_cast<Session>(*it))->notifyPropertyChanged( view, frame );
+
+	// Send them without waiting for the poll timeout
+	wakeup();
+}
+
+/**
+ * Broadcast to all session the fact that some view properties are changed
+ */
+void Kernel::broadcastViewPropertiesUpdate( ViewPtr view, const vector< PropertyPtr > & properties, WebserverConnectionPtr ignore )
+{
+	// Do not encode anything if nobody is watching the view
+	if ((view->id >= viewSubscribers.size()) || viewSubscribers[view->id].empty()) return;
+	const vector< SessionPtr > & sessions = viewSubscribers[view->id];
+
+	// Encode the frame only once
+	EgressFramePtr frame = Session::buildValuesFrame( view, properties );
+
+	// Forward to the sessions that have the view active
+	for (auto it = sessions.begin(); it != sessions.end(); ++it)
+		if (*it != ignore)
+			(*it)->notifyViewPropertiesUpdate( view, frame );
+}
+
+/**
+ * Add a session in the subscribers of a view
+ */
+void Kernel::subscribeView( const ViewPtr & view, const SessionPtr & session )
+{
+	if (view->id >= viewSubscribers.size()) return;
+	viewSubscribers[view->id].push_back( session );
+}
+
+/**
+ * Remove a session from the subscribers of a view
+ */
+void Kernel::unsubscribeView( const ViewPtr & view, const SessionPtr & session )
+{
+	if (view->id >= viewSubscribers.size()) return;
+	vector< SessionPtr > & sessions = viewSubscribers[view->id];
+
+	// The order does not matter, so swap with the last one
+	for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+		if (*it == session) {
+			*it = sessions.back();
+			sessions.pop_back();
+			return;
+		}
+	}
+}
+
+/**
+ * Mark a property as dirty, to be sent to the sessions on the next poll
+ */
+void Kernel::markPropertyAsDirty( const PropertyPtr & property )
+{
+	// Changes caused by a UI event are made by the kernel thread while
+	// it handles a session event, so they can go straight to the dirty set.
+	// The session is remembered so the value is not echoed back to it.
+	if (isPollThread() && activeConnection) {
+		addDirtyProperty( property, activeConnection );
+		wakeup();
+		return;
+	}
+
+	// Everything else goes through the lock-free queue. The property is
+	// queued only once until the kernel picks it up, and the value is
+	// read when it's flushed, so the last value wins. Only the first
+	// property after the queue is drained wakes up the kernel.
+	if (!property->queued.exchange( true )) {
+		dirtyQueue.push( property );
+		if (!dirtyQueueSignalled.exchange( true ))
+			wakeup();
+	}
+}
+
+/**
+ * Add a property in the dirty set
+ */
+void Kernel::addDirtyProperty( const PropertyPtr & property, const WebserverConnectionPtr & origin )
+{
+	// Keep the property only once per poll
+	if (!property->dirty) {
+		property->dirty = true;
+		dirtyProperties.push_back( property );
+	}
+
+	// Remember the session that made the last change, if any. A change
+	// from the application side must reach everybody.
+	if (origin) {
+		dirtyOrigins[property.get()] = origin;
+	} else if (!dirtyOrigins.empty()) {
+		dirtyOrigins.erase( property.get() );
+	}
+}
+
+/**
+ * Hold the last update event of a property that coalesces them
+ */
+void Kernel::scheduleUIUpdate( const PropertyPtr & property, int window )
+{
+	PendingUIUpdate pending;
+	pending.property = property;
+	pending.origin = activeConnection;
+	pending.deadline = chrono::steady_clock::now() + chrono::milliseconds( window );
+	pendingUpdates.push_back( pending );
+}
+
+/**
+ * Handle the held update events
+ */
+int Kernel::flushUIUpdates( bool all )
+{
+	if (pendingUpdates.empty())
+		return -1;
+
+	// Swap-out the list, the handlers may hold new updates
+	vector< PendingUIUpdate > pending;
+	pending.swap( pendingUpdates );
+
+	int timeout = -1;
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	WebserverConnectionPtr current = activeConnection;
+	for (auto it = pending.begin(); it != pending.end(); ++it) {
+
+		// Keep waiting for the window to pass
+		if (!all && ((*it).deadline > now)) {
+			int left = chrono::duration_cast< chrono::milliseconds >( (*it).deadline - now ).count() + 1;
+			if ((timeout < 0) || (left < timeout))
+				timeout = left;
+			pendingUpdates.push_back( *it );
+			continue;
+		}
+
+		// Handle it as if it came from it's session, so
+		// the new value is not echoed back to it
+		activeConnection = (*it).origin;
+		(*it).property->flushUIUpdate();
+
+	}
+	activeConnection = current;
+	return timeout;
+}
+
+/**
+ * Handle the held update event of a single property
+ */
+void Kernel::flushUIUpdate( Property * property )
+{
+	for (auto it = pendingUpdates.begin(); it != pendingUpdates.end(); ++it) {
+		if ((*it).property.get() != property)
+			continue;
+
+		// Forget it before handling it, the handlers may hold new updates
+		PendingUIUpdate pending = *it;
+		pendingUpdates.erase( it );
+
+		// Handle it as if it came from it's session
+		WebserverConnectionPtr current = activeConnection;
+		activeConnection = pending.origin;
+		pending.property->flushUIUpdate();
+		activeConnection = current;
+		return;
+	}
+}
+
+/**
+ * Send the values of all the dirty properties to the sessions
+ */
+int Kernel::flushUpdates()
+{
+	// Handle the coalesced UI updates whose window passed,
+	// or all of them if the kernel is stopping
+	int timeout = flushUIUpdates( stopping );
+
+	// Run the functions posted by other threads, before
+	// picking up the values they may have changed
+	std::function<void()> task;
+	while (taskQueue.pop( task ))
+		task();
+
+	// Nothing to do if no property changed
+	if (dirtyProperties.empty() && !dirtyQueueSignalled.load())
+		return timeout;
+
+	// Send the values at most once per update interval, and sleep until
+	// then. The writers do not wake us up again until the queue is drained.
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (!stopping && (now < nextValuesFlush)) {
+		int left = chrono::duration_cast< chrono::milliseconds >( nextValuesFlush - now ).count() + 1;
+		return ((timeout < 0) || (left < timeout)) ? left : timeout;
+	}
+
+	// Pick up the properties changed by other threads. Clearing
+	// the queued flag before the value is read guarantees that a
+	// concurrent change is either seen now or queued again.
+	dirtyQueueSignalled.store( false );
+	PropertyPtr queued;
+	while (dirtyQueue.pop( queued )) {
+		queued->queued.exchange( false );
+		addDirtyProperty( queued, WebserverConnectionPtr() );
+	}
+
+	// Nothing to do if we have no dirty properties
+	if (dirtyProperties.empty())
+		return timeout;
+	nextValuesFlush = now + chrono::milliseconds( config->updateInterval );
+
+	// Swap-out the dirty set, in case a notification marks
+	// a property as dirty again
+	vector< PropertyPtr > properties;
+	map< Property*, WebserverConnectionPtr > origins;
+	properties.swap( dirtyProperties );
+	origins.swap( dirtyOrigins );
+
+	// Group the properties per view and per session that originated
+	// the change, so every group can be sent with a single frame
+	map< pair< ViewPtr, WebserverConnectionPtr >, vector< PropertyPtr > > batches;
+	for (auto it = properties.begin(); it != properties.end(); ++it) {
+		PropertyPtr property = *it;
+		property->dirty = false;
+
+		// The property was removed from it's view after it changed
+		if (!property->isAttached())
+			continue;
+
+		// Nobody is watching the view, the values are
+		// sent to the sessions when they activate it
+		unsigned int viewID = property->view->id;
+		if ((viewID >= viewSubscribers.size()) || viewSubscribers[viewID].empty())
+			continue;
+
+		// Skip the session that originated the change
+		WebserverConnectionPtr ignore;
+		auto origin = origins.find( property.get() );
+		if (origin != origins.end())
+			ignore = (*origin).second;
+
+		batches[ make_pair( property->view, ignore ) ].push_back( property );
+	}
+
+	// Broadcast the last value of every property
+	for (auto it = batches.begin(); it != batches.end(); ++it)
+		broadcastViewPropertiesUpdate( (*it).first.first, (*it).second, (*it).first.second );
+
+	return timeout;
+}
+
+/**
+ * Unsubscribe the session of a closed websocket
+ */
+void Kernel::handleClose( TransportConnection * conn )
+{
+	WebserverConnection * c = static_cast<WebserverConnection*>(conn->handlerData);
+	if (c != NULL)
+		static_cast<Session*>(c)->activateView( ViewPtr() );
+
+	// Release the session
+	Webserver::handleClose( conn );
 }
 
 /**
@@ -168,15 +584,3 @@ WebserverConnectionPtr Kernel::openConnection( const std::string& domain, const
 			make_shared<Session>( shared_from_this(), domain, uri )
 		);
 }
-
-/**
- * Calculate and return the next view ID
- */
-string Kernel::getNextViewID()
-{
-	// Compose view ID 
-	ostringstream oss;
-	oss << "v" << (++lastViewID);
-	// Return view-index
-	return oss.str();
-}
@@ -1,61 +1,181 @@
-
 # This program is used to embed arbitrary data into a C binary. It takes
 # a list of files as an input, and produces a .c data file that contains
-# contents of all these files as collection of char arrays.
+# the index of these files, pointing into a single blob with their contents.
+#
+# Every file is also stored gzip-compressed, and brotli-compressed when
+# the IO::Compress::Brotli module is available, if that makes it smaller.
+# A SHA-1 of the contents is used as the ETag of every variant, and the
+# files are looked up by name through a hash table built here.
+#
+# With --blob the contents are written to a separate binary file that is
+# pulled in with the assembler .incbin directive, which compiles in no time.
+# Without it, the blob is printed as a char array (for compilers without
+# GNU-style inline assembly).
 #
-# Usage: perl <this_file> <file1> [file2, ...] > embedded_data.c
+# Usage: perl <this_file> [--blob <blob_file>] [--output <embedded_data.c>] <file1> [file2, ...]
 #
 # (This nice utility is borrowed from cesanta's mongoose library)
 #
 
+use IO::Compress::Gzip qw(gzip $GzipError);
+use Digest::SHA qw(sha1_hex);
+use File::Spec;
+my $have_brotli = eval { require IO::Compress::Brotli; 1 };
+
+my ($blob_file, $output_file);
+while (@ARGV && $ARGV[0] =~ /^--(blob|output)$/) {
+  shift @ARGV;
+  $blob_file = shift @ARGV if ($1 eq 'blob');
+  $output_file = shift @ARGV if ($1 eq 'output');
+}
+if (defined $output_file) {
+  open OUT, '>', $output_file or die "Cannot write $output_file: $!\n";
+  select OUT;
+}
+
+# Append all the variants of every file to the blob
+my $blob = '';
+my @variants;
 foreach my $i (0 .. $#ARGV) {
   my $f = $ARGV[$i];
   $f=$1 if ($f =~ /^(.*):/);
   open FD, '<:raw', $f or die "Cannot open $f: $!\n";
-  printf("static const unsigned char v%d[] = {", $i);
-  my $byte;
+  my $data = do { local $/; <FD> };
+  $data = '' unless defined $data;
+  close FD;
+
+  # Keep only the variants that save something
+  my ($gz, $br) = ('', '');
+  gzip(\$data => \$gz, -Level => 9, Minimal => 1) or die "gzip failed on $f: $GzipError\n";
+  $gz = '' if (length($gz) >= length($data));
+  $br = IO::Compress::Brotli::bro($data, 11) if ($have_brotli);
+  $br = '' if (length($br) >= length($data));
+
+  my @offsets;
+  foreach my $part ($data, $gz, $br) {
+    push @offsets, length($blob);
+    $blob .= $part;
+  }
+  push @variants, {
+    data => [ $offsets[0], length($data) ],
+    gzip => [ $offsets[1], length($gz) ],
+    br   => [ $offsets[2], length($br) ],
+    hash => substr(sha1_hex($data), 0, 20)
+  };
+}
+
+# The 32-bit FNV-1a hash of a string, also used by the generated code
+sub fnv1a {
+  my ($str) = @_;
+  my $h = 2166136261;
+  foreach my $byte (unpack('C*', $str)) {
+    $h = (($h ^ $byte) * 16777619) & 0xffffffff;
+  }
+  return $h;
+}
+
+# Place the files in an open-addressing hash table, at most half full
+my @names = map { my $f = $_; $f = $1 if ($f =~ /[^:]+:(.*)/); $f } @ARGV;
+my $slots = 2;
+$slots *= 2 while ($slots < 2 * scalar(@names));
+my @table = (-1) x $slots;
+foreach my $i (0 .. $#names) {
+  my $j = fnv1a($names[$i]) & ($slots - 1);
+  $j = ($j + 1) & ($slots - 1) while ($table[$j] >= 0);
+  $table[$j] = $i;
+}
+
+print <<EOS;
+#include <string.h>
+#include <marblebar/server/embedded_files.hpp>
+using namespace std;
+
+EOS
+
+if (defined $blob_file) {
+
+  # Write the blob and include it from the assembler
+  open BLOB, '>:raw', $blob_file or die "Cannot write $blob_file: $!\n";
+  print BLOB $blob;
+  close BLOB;
+  my $path = File::Spec->rel2abs($blob_file);
+  $path =~ s/\\/\//g;
+  die "Cannot embed a blob path with quotes: $path\n" if ($path =~ /"/);
+  print <<EOS;
+#if defined(__APPLE__)
+#define MB_RODATA_SECTION ".const"
+#elif defined(_WIN32)
+#define MB_RODATA_SECTION ".section .rdata,\\"dr\\""
+#else
+#define MB_RODATA_SECTION ".section .rodata"
+#endif
+
+extern const unsigned char embedded_blob[] __asm__("mb_embedded_blob");
+__asm__(
+  MB_RODATA_SECTION "\\n"
+  ".balign 16\\n"
+  "mb_embedded_blob:\\n"
+  ".incbin \\"$path\\"\\n"
+  ".byte 0\\n"
+  ".text\\n"
+);
+EOS
+
+} else {
+
+  # Print the blob as a char array
+  print "static const unsigned char embedded_blob[] = {";
   my $j = 0;
-  while (read(FD, $byte, 1)) {
+  foreach my $byte (unpack('C*', $blob)) {
     if (($j % 12) == 0) {
       print "\n";
     }
-    printf ' %#04x,', ord($byte);
+    printf ' %#04x,', $byte;
     $j++;
   }
   print " 0x00\n};\n";
-  close FD;
+
 }
 
-print <<EOS;
+print "\nstatic const mb::EmbeddedFile embedded_files[] = {\n";
 
-#include <stddef.h>
-#include <string.h>
-#include <string>
-using namespace std;
+# Return the pointer, size and ETag of a variant
+sub variant {
+  my ($v, $etag) = @_;
+  return "NULL, 0, NULL" unless ($v->[1]);
+  return "embedded_blob + $v->[0], $v->[1], \"\\\"$etag\\\"\"";
+}
 
-static const struct embedded_file {
-  const char *name;
-  const unsigned char *data;
-  size_t size;
-} embedded_files[] = {
-EOS
+foreach my $i (0 .. $#names) {
+  my $f = $names[$i];
+  my $len = length($f);
+  my $v = $variants[$i];
+  my $hash = $v->{hash};
+  my $data = "embedded_blob + $v->{data}[0], $v->{data}[1], \"\\\"$hash\\\"\"";
+  my $gzip = variant($v->{gzip}, "$hash-gz");
+  my $brotli = variant($v->{br}, "$hash-br");
+  print "  {\"$f\", $len, $data, $gzip, $brotli},\n";
+}
 
-foreach my $i (0 .. $#ARGV) {
-  my $f = $ARGV[$i];
-  $f=$1 if ($f =~ /[^:]+:(.*)/);
-  print "  {\"$f\", v$i, sizeof(v$i) - 1},\n";
+print "  {NULL, 0, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, NULL}\n};\n\n";
+print "static const int embedded_index[$slots] = {";
+foreach my $j (0 .. $slots - 1) {
+  print "\n" if (($j % 12) == 0);
+  print " $table[$j],";
 }
+print "\n};\n";
 
 print <<EOS;
-  {NULL, NULL, 0}
-};
-
-const char *find_embedded_file(const string& name, size_t *size) {
-  const struct embedded_file *p;
-  for (p = embedded_files; p->name != NULL; p++) {
-    if (!name.compare(p->name)) {
-      if (size != NULL) { *size = p->size; }
-      return (const char *) p->data;
+
+const mb::EmbeddedFile * mb::findEmbeddedFile(const char * name, size_t length) {
+  unsigned int h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h = (h ^ (unsigned char)name[i]) * 16777619u;
+  }
+  for (unsigned int j = h & ($slots - 1); embedded_index[j] >= 0; j = (j + 1) & ($slots - 1)) {
+    const mb::EmbeddedFile *p = &embedded_files[embedded_index[j]];
+    if ((p->nameLength == length) && (memcmp(p->name, name, length) == 0)) {
+      return p;
     }
   }
   return NULL;
@@ -20,6 +20,9 @@
 
 #import <Cocoa/Cocoa.h>
 #include <sstream>
+#include <pthread.h>
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
 #include "marblebar/platform.hpp"
 
 using namespace mb;
@@ -42,3 +45,19 @@ void mb::openGUIURL( ConfigPtr config )
 	]; 
 
 }
+
+/**
+ * Pin the calling thread to the specified CPU core
+ */
+bool mb::setThreadAffinity( int cpu )
+{
+
+	// OSX does not allow pinning a thread to a core, the closest we
+	// can get is to give the thread an affinity tag of it's own.
+	thread_affinity_policy_data_t policy = { cpu + 1 };
+	thread_port_t port = pthread_mach_thread_np( pthread_self() );
+
+	// Apply on the thread
+	return thread_policy_set( port, THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT ) == KERN_SUCCESS;
+
+}
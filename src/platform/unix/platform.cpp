@@ -20,6 +20,10 @@
 
 #include <sstream>
 #include "marblebar/platform.hpp"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 using namespace mb;
 
@@ -38,3 +42,28 @@ void mb::openGUIURL( ConfigPtr config )
 	system(url.c_str());
 
 }
+
+/**
+ * Pin the calling thread to the specified CPU core
+ */
+bool mb::setThreadAffinity( int cpu )
+{
+#ifdef __linux__
+
+	// Allow only the specified CPU
+	if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+		return false;
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+
+	// Apply on the thread
+	return pthread_setaffinity_np( pthread_self(), sizeof(cpu_set_t), &cpuset ) == 0;
+
+#else
+
+	// Not supported on this platform
+	return false;
+
+#endif
+}
@@ -39,3 +39,19 @@ void mb::openGUIURL( ConfigPtr config )
 	ShellExecute(NULL,"open", url.c_str(), NULL, NULL, SW_SHOWNORMAL);
 
 }
+
+/**
+ * Pin the calling thread to the specified CPU core
+ */
+bool mb::setThreadAffinity( int cpu )
+{
+
+	// Allow only the specified CPU, if the mask can express it
+	if ((cpu < 0) || (cpu >= (int)(sizeof(DWORD_PTR) * 8)))
+		return false;
+	DWORD_PTR mask = ((DWORD_PTR)1) << cpu;
+
+	// Apply on the thread
+	return SetThreadAffinityMask( GetCurrentThread(), mask ) != 0;
+
+}
@@ -33,9 +33,9 @@ PBool::PBool( const string & title, const bool & defaultValue )
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PBool::handleUIEvent( const string & event, const Json::Value & data )
+void PBool::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = data["value"].asBool();
 		this->markAsDirty();
 	}
@@ -46,7 +46,7 @@ void PBool::handleUIEvent( const string & event, const Json::Value & data )
  */
 Json::Value PBool::getUIValue()
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -55,9 +55,9 @@ Json::Value PBool::getUIValue()
 Json::Value PBool::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "toggle";
-	data["value"] = value;
+	data["value"] = value.load();
 	data["meta"] = metadata;
 	return data;
 }
@@ -71,7 +71,7 @@ Json::Value PBool::getUISpecs()
  */
 PBool::operator bool() const
 {
-	return value;
+	return value.load();
 }
 
 /**
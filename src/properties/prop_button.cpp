@@ -34,7 +34,7 @@ PButton::PButton( const string & title, const string & defaultValue )
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PButton::handleUIEvent( const string & event, const Json::Value & data )
+void PButton::handleUIEvent( unsigned int event, const Json::Value & data )
 {
 }
 
@@ -52,7 +52,7 @@ Json::Value PButton::getUIValue()
 Json::Value PButton::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "button";
 	data["value"] = value;
 	data["meta"] = metadata;
@@ -36,9 +36,9 @@ PDouble::PDouble( const string & title, const double defaultValue, const double
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PDouble::handleUIEvent( const string & event, const Json::Value & data )
+void PDouble::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = data["value"].asDouble();
 		this->markAsDirty();
 	}
@@ -49,7 +49,7 @@ void PDouble::handleUIEvent( const string & event, const Json::Value & data )
  */
 Json::Value PDouble::getUIValue()
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -58,9 +58,9 @@ Json::Value PDouble::getUIValue()
 Json::Value PDouble::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "number";
-	data["value"] = value;
+	data["value"] = value.load();
 	data["meta"] = metadata;
 	return data;
 }
@@ -74,7 +74,7 @@ Json::Value PDouble::getUISpecs()
  */
 PDouble::operator double() const
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -103,7 +103,7 @@ PDouble & PDouble::operator= ( double value )
  */
 PDouble & PDouble::operator+= ( const double & value )
 {
-	this->value += value;
+	atomicApply( this->value, [value]( double v ) { return v + value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -113,7 +113,7 @@ PDouble & PDouble::operator+= ( const double & value )
  */
 PDouble & PDouble::operator+= ( double value )
 {
-	this->value += value;
+	atomicApply( this->value, [value]( double v ) { return v + value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -123,7 +123,7 @@ PDouble & PDouble::operator+= ( double value )
  */
 PDouble & PDouble::operator-= ( const double & value )
 {
-	this->value -= value;
+	atomicApply( this->value, [value]( double v ) { return v - value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -133,7 +133,7 @@ PDouble & PDouble::operator-= ( const double & value )
  */
 PDouble & PDouble::operator-= ( double value )
 {
-	this->value -= value;
+	atomicApply( this->value, [value]( double v ) { return v - value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -143,7 +143,7 @@ PDouble & PDouble::operator-= ( double value )
  */
 PDouble & PDouble::operator/= ( const double & value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( double v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -153,7 +153,7 @@ PDouble & PDouble::operator/= ( const double & value )
  */
 PDouble & PDouble::operator/= ( double value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( double v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -163,7 +163,7 @@ PDouble & PDouble::operator/= ( double value )
  */
 PDouble & PDouble::operator*= ( const double & value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( double v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -173,7 +173,7 @@ PDouble & PDouble::operator*= ( const double & value )
  */
 PDouble & PDouble::operator*= ( double value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( double v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -36,9 +36,9 @@ PFloat::PFloat( const string & title, const float defaultValue, const float min,
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PFloat::handleUIEvent( const string & event, const Json::Value & data )
+void PFloat::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = (float)( data["value"].asDouble() );
 		this->markAsDirty();
 	}
@@ -49,7 +49,7 @@ void PFloat::handleUIEvent( const string & event, const Json::Value & data )
  */
 Json::Value PFloat::getUIValue()
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -58,9 +58,9 @@ Json::Value PFloat::getUIValue()
 Json::Value PFloat::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "slider";
-	data["value"] = value;
+	data["value"] = value.load();
 	data["meta"] = metadata;
 	return data;
 }
@@ -74,7 +74,7 @@ Json::Value PFloat::getUISpecs()
  */
 PFloat::operator float() const
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -103,7 +103,7 @@ PFloat & PFloat::operator= ( float value )
  */
 PFloat & PFloat::operator+= ( const float & value )
 {
-	this->value += value;
+	atomicApply( this->value, [value]( float v ) { return v + value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -113,7 +113,7 @@ PFloat & PFloat::operator+= ( const float & value )
  */
 PFloat & PFloat::operator+= ( float value )
 {
-	this->value += value;
+	atomicApply( this->value, [value]( float v ) { return v + value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -123,7 +123,7 @@ PFloat & PFloat::operator+= ( float value )
  */
 PFloat & PFloat::operator-= ( const float & value )
 {
-	this->value -= value;
+	atomicApply( this->value, [value]( float v ) { return v - value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -133,7 +133,7 @@ PFloat & PFloat::operator-= ( const float & value )
  */
 PFloat & PFloat::operator-= ( float value )
 {
-	this->value -= value;
+	atomicApply( this->value, [value]( float v ) { return v - value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -143,7 +143,7 @@ PFloat & PFloat::operator-= ( float value )
  */
 PFloat & PFloat::operator/= ( const float & value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( float v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -153,7 +153,7 @@ PFloat & PFloat::operator/= ( const float & value )
  */
 PFloat & PFloat::operator/= ( float value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( float v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -163,7 +163,7 @@ PFloat & PFloat::operator/= ( float value )
  */
 PFloat & PFloat::operator*= ( const float & value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( float v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -173,7 +173,7 @@ PFloat & PFloat::operator*= ( const float & value )
  */
 PFloat & PFloat::operator*= ( float value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( float v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
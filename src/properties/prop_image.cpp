@@ -40,7 +40,7 @@ PImage::PImage( const string & title, const int width, const int height, const s
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PImage::handleUIEvent( const string & event, const Json::Value & data )
+void PImage::handleUIEvent( unsigned int event, const Json::Value & data )
 {
 
 }
@@ -59,7 +59,7 @@ Json::Value PImage::getUIValue()
 Json::Value PImage::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "image";
 	data["value"] = value;
 	data["meta"] = metadata;
@@ -36,9 +36,9 @@ PInt::PInt( const string & title, const int defaultValue, const int min, const i
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PInt::handleUIEvent( const string & event, const Json::Value & data )
+void PInt::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = data["value"].asInt();
 		this->markAsDirty();
 	}
@@ -49,7 +49,7 @@ void PInt::handleUIEvent( const string & event, const Json::Value & data )
  */
 Json::Value PInt::getUIValue()
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -58,9 +58,9 @@ Json::Value PInt::getUIValue()
 Json::Value PInt::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "slider";
-	data["value"] = value;
+	data["value"] = value.load();
 	data["meta"] = metadata;
 	return data;
 }
@@ -74,7 +74,7 @@ Json::Value PInt::getUISpecs()
  */
 PInt::operator int() const
 {
-	return value;
+	return value.load();
 }
 
 /**
@@ -143,7 +143,7 @@ PInt & PInt::operator-= ( int value )
  */
 PInt & PInt::operator/= ( const int & value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( int v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -153,7 +153,7 @@ PInt & PInt::operator/= ( const int & value )
  */
 PInt & PInt::operator/= ( int value )
 {
-	this->value /= value;
+	atomicApply( this->value, [value]( int v ) { return v / value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -163,7 +163,7 @@ PInt & PInt::operator/= ( int value )
  */
 PInt & PInt::operator*= ( const int & value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( int v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
@@ -173,7 +173,7 @@ PInt & PInt::operator*= ( const int & value )
  */
 PInt & PInt::operator*= ( int value )
 {
-	this->value *= value;
+	atomicApply( this->value, [value]( int v ) { return v * value; } );
 	this->markAsDirty();
 	return *this;
 }
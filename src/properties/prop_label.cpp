@@ -33,9 +33,9 @@ PLabel::PLabel( const string & title, const string & defaultValue )
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PLabel::handleUIEvent( const string & event, const Json::Value & data )
+void PLabel::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = data["value"].asString();
 		this->markAsDirty();
 	}
@@ -55,7 +55,7 @@ Json::Value PLabel::getUIValue()
 Json::Value PLabel::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "label";
 	data["value"] = value;
 	data["meta"] = metadata;
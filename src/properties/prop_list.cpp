@@ -33,9 +33,9 @@ PList::PList( const string & title, const int & defaultIndex )
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PList::handleUIEvent( const string & event, const Json::Value & data )
+void PList::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		// Update index
 		index = data["index"].asInt();
 		this->markAsDirty();
@@ -49,6 +49,7 @@ PListPtr PList::addOption( const string & name, const string & value )
 {
 	// Update options
 	options.push_back( make_pair( name, value ) );
+	specsChanged();
 
 	// Return a shared pointer to this
 	return dynamic_pointer_cast<PList>( shared_from_this() );
@@ -59,7 +60,7 @@ PListPtr PList::addOption( const string & name, const string & value )
  */
 Json::Value PList::getUIValue()
 {
-	return index;
+	return index.load();
 }
 
 /**
@@ -77,9 +78,9 @@ Json::Value PList::getUISpecs()
 		options.append( opt );
 	}
 
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "list";
-	data["value"] = index;
+	data["value"] = index.load();
 	data["options"] = options;
 	data["meta"] = metadata;
 	return data;
@@ -94,7 +95,7 @@ Json::Value PList::getUISpecs()
  */
 PList::operator int() const
 {
-	return index;
+	return index.load();
 }
 
 /**
@@ -102,7 +103,7 @@ PList::operator int() const
  */
 PList::operator string() const
 {
-	return options[index].second;
+	return options[index.load()].second;
 }
 
 /**
@@ -33,9 +33,9 @@ PString::PString( const string & title, const string & defaultValue )
 /**
  * Overridable function to apply a property change to it's contents
  */
-void PString::handleUIEvent( const string & event, const Json::Value & data )
+void PString::handleUIEvent( unsigned int event, const Json::Value & data )
 {
-	if (event == "update") {
+	if (event == EventNames::UPDATE) {
 		value = data["value"].asString();
 		this->markAsDirty();
 	}
@@ -55,7 +55,7 @@ Json::Value PString::getUIValue()
 Json::Value PString::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "text";
 	data["value"] = value;
 	data["meta"] = metadata;
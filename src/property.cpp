@@ -28,7 +28,8 @@ using namespace std;
  * Property constructor
  */
 Property::Property()
- : metadata(), attached(false), eventCallbacks()
+ : metadata(), id(0), dirty(false), queued(false), attached(false), 
+   coalesceWindow(-1), pendingUpdate(), updatePending(false), eventCallbacks()
 { }
 
 /**
@@ -38,6 +39,20 @@ PropertyPtr Property::meta( const string & property, const Json::Value & value )
 {
 	// Update property
 	metadata[property] = value;
+
+	// Coalesce the updates within a poll (true) or a window in milliseconds
+	if (property == "coalesce") {
+		if (value.isBool()) {
+			coalesceWindow = value.asBool() ? 0 : -1;
+		} else if (value.isNumeric()) {
+			coalesceWindow = (value.asInt() >= 0) ? value.asInt() : -1;
+		} else {
+			coalesceWindow = -1;
+		}
+	}
+
+	// Patch the widget in the sessions
+	specsChanged();
 	// Return instance for chaining calls
 	return shared_from_this();
 }
@@ -47,10 +62,17 @@ PropertyPtr Property::meta( const string & property, const Json::Value & value )
  */
 PropertyPtr Property::on( const string & event, EventCallback callback )
 {
-	// Create a vector of event callbacks
-	if (eventCallbacks.find(event) == eventCallbacks.end()) {
-		eventCallbacks[event] = vector< EventCallback >();
-	}
+	return on( EventNames::intern( event ), callback );
+}
+
+/**
+ * Register an event handler by the interned event ID
+ */
+PropertyPtr Property::on( unsigned int event, EventCallback callback )
+{
+	// Make room for the event callbacks
+	if (event >= eventCallbacks.size())
+		eventCallbacks.resize( event + 1 );
 
 	// Register event callback
 	eventCallbacks[event].push_back( callback );
@@ -62,13 +84,43 @@ PropertyPtr Property::on( const string & event, EventCallback callback )
 /**
  * Marblebar Property constructor
  */
-void Property::attach( const ViewPtr& view, const string & id )
+void Property::attach( const ViewPtr& view, unsigned int id )
 {
 	this->view = view;
 	this->id = id;
 	this->attached = true;
 }
 
+/**
+ * Detach from the view
+ */
+void Property::detach()
+{
+	this->attached = false;
+}
+
+/**
+ * Check if the property is still part of it's view
+ */
+bool Property::isAttached() const
+{
+	return this->attached;
+}
+
+/**
+ * Send the new specifications of the property to the sessions
+ */
+void Property::specsChanged()
+{
+	// Do not do anything unless attached
+	if (!this->attached) return;
+
+	// The specs of the view include the ones of the property
+	view->invalidateSpecs();
+	if (view->kernel)
+		view->kernel->broadcastPropertyUpdated( view, shared_from_this() );
+}
+
 /**
  * Mark property as dirty
  */
@@ -87,7 +139,7 @@ void Property::markAsDirty()
 Json::Value Property::getUISpecs()
 {
 	Json::Value data;
-	data["id"] = id;
+	data["id"] = formatUIID( 'p', id );
 	data["widget"] = "text";
 	data["value"] = getUIValue();
 	data["meta"] = metadata;
@@ -95,20 +147,74 @@ Json::Value Property::getUISpecs()
 }
 
 /**
- * Overridable function to apply a property change to it's contents
+ * Receive a UI event
+ */
+void Property::receiveUIEvent( unsigned int event, const Json::Value & data )
+{
+	if (this->attached && view->kernel) {
+
+		// Keep only the last update of a burst, and let
+		// the kernel handle it when the window passes
+		if ((event == EventNames::UPDATE) && (coalesceWindow >= 0)) {
+			pendingUpdate = data;
+			if (!updatePending) {
+				updatePending = true;
+				view->kernel->scheduleUIUpdate( shared_from_this(), coalesceWindow );
+			}
+			return;
+		}
+
+		// Everything else is never merged, and is handled
+		// after the update of this property that came before it
+		if (updatePending)
+			view->kernel->flushUIUpdate( this );
+
+	}
+
+	dispatchUIEvent( event, data );
+}
+
+/**
+ * Handle the update event held for coalescing
+ */
+void Property::flushUIUpdate()
+{
+	if (!updatePending) return;
+	updatePending = false;
+
+	// Release the held value before handling it, and drop
+	// it if the property was removed from it's view meanwhile
+	Json::Value data;
+	data.swap( pendingUpdate );
+	if (!this->attached) return;
+	dispatchUIEvent( EventNames::UPDATE, data );
+}
+
+/**
+ * Apply a property change by the name of the event, for
+ * the properties that handle the events by their name
+ */
+void Property::handleUIEvent( unsigned int event, const Json::Value & data )
+{
+	handleUIEvent( EventNames::name( event ), data );
+}
+
+/**
+ * Pass a UI event to the handler of the property and to the callbacks
  */
-void Property::receiveUIEvent( const string & event, const Json::Value & data )
+void Property::dispatchUIEvent( unsigned int event, const Json::Value & data )
 {
 
 	// Forward to the UI event handler of the property
 	handleUIEvent( event, data );
 
 	// Lookup listeners
-	if (eventCallbacks.find(event) == eventCallbacks.end())
+	if (event >= eventCallbacks.size())
 		return;
 
 	// Trigger them
-	for (auto it = eventCallbacks[event].begin(); it != eventCallbacks[event].end(); ++it)
+	const vector< EventCallback > & callbacks = eventCallbacks[event];
+	for (auto it = callbacks.begin(); it != callbacks.end(); ++it)
 		(*it)( data );
 
 }
@@ -19,6 +19,8 @@
  */
 
 #include "marblebar/session.hpp"
+#include "marblebar/binary_protocol.hpp"
+#include "marblebar/event_names.hpp"
 #include <iostream>
 
 using namespace mb;
@@ -34,12 +36,21 @@ Session::Session( KernelPtr kernel, const string& domain, const string uri ) :
  * Notify to session the fact that a view is added
  */
 void Session::notifyViewAdded( ViewPtr view )
+{
+	// Encode and trigger view add
+	notifyViewAdded( view, view->getSpecsFrame() );
+}
+
+/**
+ * Notify to session the fact that a view is added, using an encoded frame
+ */
+void Session::notifyViewAdded( ViewPtr view, const EgressFramePtr & frame )
 {
 	// Trigger view add
-	sendAction( "view/add", view->getUISpecs() );
+	sendFrame( frame );
 	// Activate first view
 	if (!activeView)
-		activeView = view;
+		activateView( view );
 }
 
 /**
@@ -48,39 +59,136 @@ void Session::notifyViewAdded( ViewPtr view )
 void Session::notifyViewRemoved( ViewPtr view )
 {
 	Json::Value data;
-	data["id"] = view->id;
+	data["id"] = formatUIID( 'v', view->id );
+	// Encode and trigger view remove
+	notifyViewRemoved( view, buildAction( "view/remove", data ) );
+}
+
+/**
+ * Notify to session the fact that a view is removed, using an encoded frame
+ */
+void Session::notifyViewRemoved( ViewPtr view, const EgressFramePtr & frame )
+{
 	// Trigger view remove
-	sendAction( "view/remove", data );
+	sendFrame( frame );
 }
 
 /**
  * Notify to session the fact that a view is updated
  */
 void Session::notifyViewUpdated( ViewPtr view )
+{
+	// Do not encode view update if view not active
+	if (activeView != view) return;
+
+	// Encode and trigger view update
+	notifyViewUpdated( view, buildAction( "view/update", view->getUISpecs() ) );
+}
+
+/**
+ * Notify to session the fact that a view is updated, using an encoded frame
+ */
+void Session::notifyViewUpdated( ViewPtr view, const EgressFramePtr & frame )
 {
 	// Do not send view update if view not active
 	if (activeView != view) return;
 
 	// Trigger view update
-	sendAction( "view/update", view->getUISpecs() );
+	sendFrame( frame );
 }
 
 /**
- * Notify to session the fact that a view property is changed
+ * Notify to session a structural or metadata change of a view property
  */
-void Session::notifyViewPropertyUpdate( ViewPtr view, PropertyPtr property )
+void Session::notifyPropertyChanged( ViewPtr view, const EgressFramePtr & frame )
 {
-	// Do not send view update if view not active
+	// All the views are rendered in the browser, so
+	// patch the widget even if the view is not active
+	sendFrame( frame );
+}
+
+/**
+ * Notify to session the fact that some view properties are changed
+ */
+void Session::notifyViewPropertiesUpdate( ViewPtr view, const vector< PropertyPtr > & properties )
+{
+	// Do not encode view update if view not active
 	if (activeView != view) return;
 
-	// Set property update
-	Json::Value data;
-	data["id"] = view->id;
-	data["prop"] = property->id;
-	data["value"] = property->getUIValue();
+	// Encode and trigger a single view property change for all of them
+	notifyViewPropertiesUpdate( view, buildValuesFrame( view, properties ) );
+}
+
+/**
+ * Notify to session the fact that some view properties are changed, using an encoded frame
+ */
+void Session::notifyViewPropertiesUpdate( ViewPtr view, const EgressFramePtr & frame )
+{
+	// Do not send view update if view not active
+	if (activeView != view) return;
 
 	// Trigger view property change
-	sendAction( "view/propchange", data );
+	sendFrame( frame );
+}
+
+/**
+ * Change the active view of the session
+ */
+void Session::activateView( ViewPtr view )
+{
+	if (activeView == view) return;
+
+	// Move between the view subscribers
+	if (activeView)
+		kernel->unsubscribeView( activeView, shared_from_this() );
+	activeView = view;
+	if (activeView)
+		kernel->subscribeView( activeView, shared_from_this() );
+}
+
+/**
+ * Encode the values of some view properties to a shareable frame
+ */
+EgressFramePtr Session::buildValuesFrame( ViewPtr view, const vector< PropertyPtr > & properties )
+{
+	// Keep the values next to the encoded frames, so they can be
+	// conflated in the egress queue of a slow session
+	PropertyValues values;
+	values.reserve( properties.size() );
+	for (auto it = properties.begin(); it != properties.end(); ++it)
+		values.push_back( make_pair( (*it)->id, (*it)->getUIValue() ) );
+	return make_shared<EgressFrame>( 
+		encodeAction( "view/propchange-batch", buildValuesData( view->id, values ) ), view->id, values,
+		BinaryProtocol::encodeValues( view->id, values ) );
+}
+
+/**
+ * Build the JSON data of a values frame, with the string form of the IDs
+ */
+Json::Value Session::buildValuesData( unsigned int view, const PropertyValues & values )
+{
+	Json::Value data, props(Json::arrayValue);
+	for (auto it = values.begin(); it != values.end(); ++it) {
+		Json::Value prop;
+		prop["prop"] = formatUIID( 'p', it->first );
+		prop["value"] = it->second;
+		props.append( prop );
+	}
+	data["id"] = formatUIID( 'v', view );
+	data["props"] = props;
+	return data;
+}
+
+/**
+ * Encode the property values merged in the egress queue
+ */
+EgressFramePtr Session::encodeValues( unsigned int view, const PropertyValues& values )
+{
+	// Use the compact encoding if the browser asked for it
+	if (binary)
+		return make_shared<EgressFrame>( "", 0, PropertyValues(), BinaryProtocol::encodeValues( view, values ) );
+
+	return buildAction( "view/propchange-batch", buildValuesData( view, values ) );
 }
 
 /**
@@ -88,10 +196,77 @@ void Session::notifyViewPropertyUpdate( ViewPtr view, PropertyPtr property )
  */
 void Session::updateViewProperties( ViewPtr view )
 {
-	// Send updates to all view properties
-	for (auto it = view->propertyGroups.begin(); it != view->propertyGroups.end(); ++it)
-		for (auto jt = (*it).second->properties.begin(); jt != (*it).second->properties.end(); ++jt)
-			notifyViewPropertyUpdate( view, (*jt) );
+	// Send updates to all the view properties, skipping the removed ones
+	vector< PropertyPtr > properties;
+	properties.reserve( view->properties.size() );
+	for (auto it = view->properties.begin(); it != view->properties.end(); ++it)
+		if (*it) properties.push_back( *it );
+	notifyViewPropertiesUpdate( view, properties );
+}
+
+/**
+ * Property event handler
+ */
+void Session::handlePropertyEvent( const PropertyEvent& event )
+{
+	// Locate the view and the property with the specified IDs
+	ViewPtr view = kernel->getViewByID( event.view );
+	if (!view) {
+		sendError("Specified view was not found", event.id);
+		return;
+	}
+	PropertyPtr prop = view->propertyById( event.prop );
+	if (!prop) {
+		sendError("Specified property was not found", event.id);
+		return;
+	}
+
+	// Handle event by the property, nothing listens to unknown events
+	if (event.nameID != EventNames::UNKNOWN)
+		prop->receiveUIEvent( event.nameID, event.data );
+}
+
+/**
+ * Keep an action handler in a table, indexed by the interned action name
+ */
+static void store_action( vector< SessionAction > & table, const string & name, SessionAction action )
+{
+	unsigned int index = EventNames::intern( name );
+	if (index >= table.size())
+		table.resize( index + 1 );
+	table[index] = action;
+}
+
+/**
+ * Return the handlers of the built-in actions
+ */
+vector< SessionAction > Session::builtinActions()
+{
+	vector< SessionAction > table;
+	store_action( table, "ui/init", []( Session & s, const string & id, const Json::Value & data ) 
+		{ s.handleInit( id, data ); } );
+	store_action( table, "view/activate", []( Session & s, const string & id, const Json::Value & data ) 
+		{ s.handleActivate( id, data ); } );
+	store_action( table, "property/event", []( Session & s, const string & id, const Json::Value & data ) 
+		{ s.handlePropertyAction( id, data ); } );
+	return table;
+}
+
+/**
+ * Return the action handlers
+ */
+vector< SessionAction > & Session::actions()
+{
+	static vector< SessionAction > table = builtinActions();
+	return table;
+}
+
+/**
+ * Register the handler of an action sent by the browser
+ */
+void Session::registerAction( const string & name, SessionAction action )
+{
+	store_action( actions(), name, action );
 }
 
 /**
@@ -99,81 +274,94 @@ void Session::updateViewProperties( ViewPtr view )
  */
 void Session::handleEvent( const string& id, const string& event, const Json::Value& data )
 {
-	
-	if (event == "ui/init") {
-
-		// Initialize the UI by sending all the view specifications
-		for (auto it = kernel->views.begin(); it != kernel->views.end(); ++it) {
-			this->notifyViewAdded( *it );
-		}
+	// Route by the interned name of the action
+	const vector< SessionAction > & table = actions();
+	unsigned int index = EventNames::find( event );
+	if ((index < table.size()) && table[index]) {
+		table[index]( *this, id, data );
+	} else {
+		sendError("Unknown event received", id);
+	}
+}
 
-	} else if (event == "view/activate") {
+/**
+ * Initialize the UI of the session
+ */
+void Session::handleInit( const string& id, const Json::Value& data )
+{
+	// Use binary frames for the property values if the browser can decode them
+	binary = data.isObject() && data.isMember("binary") && data["binary"].asBool();
 
-		// Require view property
-	    if (!data.isMember("view")) {
-	        sendError("Missing 'view' parameter in the incoming request", id);
-	        return;
-	    }
+	// Initialize the UI by sending all the view specifications
+	for (auto it = kernel->views.begin(); it != kernel->views.end(); ++it) {
+		this->notifyViewAdded( *it );
+	}
 
-		// Activate a specific view
-		activeView = kernel->getViewByID( data["view"].asString() );
+	// The specifications are shared between sessions and may
+	// carry older values, so send the current ones
+	if (activeView)
 		updateViewProperties( activeView );
+}
 
-	} else if (event == "property/event") {
-
-	    // Ensure we have an action defined
-	    if (!data.isMember("view")) {
-	        sendError("Missing 'view' parameter in the incoming request", id);
-	        return;
-	    }
-	    if (!data.isMember("prop")) {
-	        sendError("Missing 'prop' parameter in the incoming request", id);
-	        return;
-	    }
-	    if (!data.isMember("name")) {
-	        sendError("Missing 'name' parameter in the incoming request", id);
-	        return;
-	    }
-	    if (!data.isMember("data")) {
-	        sendError("Missing 'data' parameter in the incoming request", id);
-	        return;
-	    }
-	    // Fetch view and property id
-	    string viewName = data["view"].asString();
-	    string propName = data["prop"].asString();
-	    string event = data["name"].asString();
-
-		// Locate a view with the specified ID
-		for (auto it = kernel->views.begin(); it != kernel->views.end(); ++it) {
-			ViewPtr view = *it;
-
-			// Find view
-			if (view->id == viewName) {
-
-				// Locate property with specified ID
-				PropertyPtr prop = view->propertyById( propName );
-				if (prop) {
-					// Handle event by the property
-					prop->receiveUIEvent( event, data["data"] );
-					// Do not continue
-					return;
-				}
-
-				// Property not found
-				sendError("Specified property was not found", id);
-				return;
-			}
-
-		}
-
-		// View not found
-		sendError("Specified view was not found", id);
+/**
+ * Activate a view of the session
+ */
+void Session::handleActivate( const string& id, const Json::Value& data )
+{
+	// Require view property
+	if (!data.isMember("view")) {
+		sendError("Missing 'view' parameter in the incoming request", id);
+		return;
+	}
 
-	} else {
+	// Activate a specific view
+	ViewPtr view = kernel->getViewByID( data["view"].asString() );
+	if (!view) {
+		sendError("Specified view was not found", id);
+		return;
+	}
+	activateView( view );
+	updateViewProperties( view );
+}
 
-		// Send error
-		sendError("Unknown event received", id);
+/**
+ * Handle a property event that was not parsed by the ingress parser
+ */
+void Session::handlePropertyAction( const string& id, const Json::Value& data )
+{
+	// Ensure we have an action defined
+	if (!data.isMember("view")) {
+		sendError("Missing 'view' parameter in the incoming request", id);
+		return;
+	}
+	if (!data.isMember("prop")) {
+		sendError("Missing 'prop' parameter in the incoming request", id);
+		return;
+	}
+	if (!data.isMember("name")) {
+		sendError("Missing 'name' parameter in the incoming request", id);
+		return;
+	}
+	if (!data.isMember("data")) {
+		sendError("Missing 'data' parameter in the incoming request", id);
+		return;
+	}
 
+	// Fetch view and property id
+	PropertyEvent propEvent;
+	propEvent.id = id;
+	propEvent.name = data["name"].asString();
+	propEvent.nameID = EventNames::find( propEvent.name );
+	propEvent.data = data["data"];
+	if (!parseUIID( 'v', data["view"].asString(), propEvent.view )) {
+		sendError("Specified view was not found", id);
+		return;
+	}
+	if (!parseUIID( 'p', data["prop"].asString(), propEvent.prop )) {
+		sendError("Specified property was not found", id);
+		return;
 	}
 
+	// Handle it like the ones parsed by the ingress parser
+	handlePropertyEvent( propEvent );
 }
@@ -0,0 +1,40 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#include "marblebar/server/transport.hpp"
+#include "marblebar/server/transport_mongoose.hpp"
+#include "marblebar/server/transport_epoll.hpp"
+
+using namespace mb;
+
+/**
+ * Create the transport selected in the configuration
+ */
+TransportPtr Transport::create( ConfigPtr config, TransportHandler * handler )
+{
+#ifdef __linux__
+    // The native backend is the default on linux
+    if (config->webserverTransport != "mongoose")
+        return make_shared<EpollTransport>( config, handler );
+#endif
+
+    // Mongoose works everywhere else
+    return make_shared<MongooseTransport>( config, handler );
+}
@@ -0,0 +1,1004 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#ifdef __linux__
+
+#include "marblebar/server/transport_epoll.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace mb;
+
+/**
+ * Maximum size of the request headers and of a websocket message
+ */
+#define MAX_HEADER_SIZE     65536
+#define MAX_MESSAGE_SIZE    (16*1024*1024)
+
+/**
+ * Maximum number of events handled by every epoll_wait
+ */
+#define MAX_EVENTS          64
+
+/**
+ * Return the reason phrase of an HTTP status code
+ */
+static const char * status_text( int code )
+{
+    switch (code) {
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 416: return "Requested Range Not Satisfiable";
+        default:  return "Internal Server Error";
+    }
+}
+
+/**
+ * Decode the %XX escapes of a URI
+ */
+static string url_decode( const string & src )
+{
+    string ans;
+    ans.reserve( src.length() );
+    for (size_t i=0; i<src.length(); ++i) {
+        if ((src[i] == '%') && (i+2 < src.length()) && isxdigit(src[i+1]) && isxdigit(src[i+2])) {
+            char hex[3] = { src[i+1], src[i+2], 0 };
+            ans += (char) strtol( hex, NULL, 16 );
+            i += 2;
+        } else {
+            ans += src[i];
+        }
+    }
+    return ans;
+}
+
+/**
+ * Calculate the SHA-1 digest of the given data
+ */
+static void sha1( const string & data, unsigned char digest[20] )
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    // Pad the message to a multiple of 64 bytes
+    string msg = data;
+    uint64_t bits = (uint64_t)data.length() * 8;
+    msg += (char)0x80;
+    while (msg.length() % 64 != 56)
+        msg += (char)0x00;
+    for (int i=7; i>=0; --i)
+        msg += (char)((bits >> (i*8)) & 0xFF);
+
+    // Process every 64-byte chunk
+    for (size_t chunk=0; chunk<msg.length(); chunk+=64) {
+        uint32_t w[80];
+        for (int i=0; i<16; ++i) {
+            const unsigned char * p = (const unsigned char *)msg.data() + chunk + i*4;
+            w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        }
+        for (int i=16; i<80; ++i) {
+            uint32_t v = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+            w[i] = (v << 1) | (v >> 31);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i=0; i<80; ++i) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);            k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                     k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d);   k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                     k = 0xCA62C1D6; }
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i=0; i<20; ++i)
+        digest[i] = (h[i/4] >> (24 - (i%4)*8)) & 0xFF;
+}
+
+/**
+ * Encode the given data to base64
+ */
+static string base64_encode( const unsigned char * data, size_t len )
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string ans;
+    for (size_t i=0; i<len; i+=3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i+1 < len) v |= (uint32_t)data[i+1] << 8;
+        if (i+2 < len) v |= data[i+2];
+        ans += table[(v >> 18) & 0x3F];
+        ans += table[(v >> 12) & 0x3F];
+        ans += (i+1 < len) ? table[(v >> 6) & 0x3F] : '=';
+        ans += (i+2 < len) ? table[v & 0x3F] : '=';
+    }
+    return ans;
+}
+
+/**
+ * Wrap an accepted socket
+ */
+EpollConnection::EpollConnection( EpollTransport * transport, int fd )
+    : transport(transport), fd(fd), websocket(false), closing(false), closed(false),
+      input(), output(), outputOffset(0), uri(), headers(), responseStatus(200),
+      responseHeaders(), responseBody(), fileFD(-1), fileOffset(0), fileRemaining(0), fragmentOpcode(0), fragment(), fragmentCompressed(false),
+      deflater(NULL), inflater(NULL), deflateNoContext(false)
+{
+}
+
+/**
+ * Release the compression streams and the file being sent
+ */
+EpollConnection::~EpollConnection()
+{
+    closeFile();
+#ifdef HAVE_ZLIB
+    if (deflater) {
+        deflateEnd( deflater );
+        delete deflater;
+    }
+    if (inflater) {
+        inflateEnd( inflater );
+        delete inflater;
+    }
+#endif
+}
+
+/**
+ * Return the URI of the request
+ */
+const char * EpollConnection::getURI()
+{
+    return uri.c_str();
+}
+
+/**
+ * Return the value of a request header
+ */
+const char * EpollConnection::getHeader( const char * name )
+{
+    for (size_t i=0; i<headers.size(); ++i) {
+        if (strcasecmp( headers[i].first.c_str(), name ) == 0)
+            return headers[i].second.c_str();
+    }
+    return NULL;
+}
+
+/**
+ * Set the status code of the HTTP response
+ */
+void EpollConnection::sendStatus( int code )
+{
+    responseStatus = code;
+}
+
+/**
+ * Add a header to the HTTP response
+ */
+void EpollConnection::sendHeader( const char * name, const char * value )
+{
+    responseHeaders += name;
+    responseHeaders += ": ";
+    responseHeaders += value;
+    responseHeaders += "\r\n";
+}
+
+/**
+ * Append data to the body of the HTTP response
+ */
+void EpollConnection::sendData( const char * data, size_t len )
+{
+    responseBody.append( data, len );
+}
+
+/**
+ * Append a file region to the body of the HTTP response
+ */
+void EpollConnection::sendFile( int fd, off_t offset, size_t len )
+{
+    // Only one file per response, sent after the rest of the body
+    if (fileFD >= 0) {
+        ::close( fd );
+        return;
+    }
+    fileFD = fd;
+    fileOffset = offset;
+    fileRemaining = len;
+}
+
+/**
+ * Close the file being sent
+ */
+void EpollConnection::closeFile()
+{
+    if (fileFD < 0) return;
+    ::close( fileFD );
+    fileFD = -1;
+    fileRemaining = 0;
+}
+
+/**
+ * Send a websocket frame
+ */
+void EpollConnection::sendFrame( int opcode, const char * data, size_t len )
+{
+    if (closing || closed) return;
+
+    // Compress data frames that are big enough
+    string compressed;
+    char flags = 0x80;
+    if (deflater && !(opcode & 0x08) && (len >= transport->deflateThreshold) && deflateMessage( data, len, compressed )) {
+        flags |= 0x40;
+        data = compressed.data();
+        len = compressed.length();
+    }
+
+    // Server frames are never masked nor fragmented
+    output += (char)(flags | (opcode & 0x0F));
+    if (len < 126) {
+        output += (char)len;
+    } else if (len <= 0xFFFF) {
+        output += (char)126;
+        output += (char)((len >> 8) & 0xFF);
+        output += (char)(len & 0xFF);
+    } else {
+        output += (char)127;
+        for (int i=7; i>=0; --i)
+            output += (char)(((uint64_t)len >> (i*8)) & 0xFF);
+    }
+    if (len > 0)
+        output.append( data, len );
+
+    // Write right away, the socket is waited for only if it is full
+    handleWritable();
+}
+
+/**
+ * Close the socket after the pending data are sent
+ */
+void EpollConnection::close()
+{
+    if (closing || closed) return;
+
+    // Websockets say goodbye with a close frame
+    if (websocket)
+        sendFrame( 0x08, NULL, 0 );
+    closing = true;
+    handleWritable();
+}
+
+/**
+ * Return the number of bytes not yet written to the socket
+ */
+size_t EpollConnection::getPendingBytes()
+{
+    return output.length() - outputOffset + fileRemaining;
+}
+
+/**
+ * Mark the socket as closed, to be released by the transport
+ */
+void EpollConnection::markClosed()
+{
+    if (closed) return;
+    closed = true;
+    transport->closedConnections.push_back( this );
+}
+
+/**
+ * Read everything available on the socket
+ */
+void EpollConnection::handleReadable()
+{
+    char buf[16384];
+
+    // With edge-triggered events we must read until the socket is drained
+    for (;;) {
+        ssize_t n = ::recv( fd, buf, sizeof(buf), 0 );
+        if (n > 0) {
+            input.append( buf, n );
+        } else if (n == 0) {
+            markClosed();
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                markClosed();
+            break;
+        }
+    }
+
+    // Process what we got, even if the peer closed its side
+    if (closing) {
+        input.clear();
+    } else if (!input.empty()) {
+        bool ok = websocket ? processWebsocket() : processHTTP();
+        if (!ok) markClosed();
+    }
+}
+
+/**
+ * Write as much of the output buffer as the socket accepts
+ */
+void EpollConnection::handleWritable()
+{
+    if (closed) return;
+
+    while (outputOffset < output.length()) {
+        ssize_t n = ::send( fd, output.data() + outputOffset, output.length() - outputOffset, MSG_NOSIGNAL );
+        if (n > 0) {
+            outputOffset += n;
+        } else if ((n < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            // Wait for EPOLLOUT
+            return;
+        } else {
+            markClosed();
+            return;
+        }
+    }
+
+    output.clear();
+    outputOffset = 0;
+
+    // Then the file, straight from the page cache
+    while (fileRemaining > 0) {
+        size_t chunk = (fileRemaining > 0x40000000) ? 0x40000000 : fileRemaining;
+        ssize_t n = ::sendfile( fd, fileFD, &fileOffset, chunk );
+        if (n > 0) {
+            fileRemaining -= n;
+        } else if ((n < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            // Wait for EPOLLOUT
+            return;
+        } else {
+            // The file was truncated, or failed, so the promised length can't be sent
+            closeFile();
+            markClosed();
+            return;
+        }
+    }
+    closeFile();
+
+    // Everything is sent
+    if (closing)
+        markClosed();
+}
+
+/**
+ * Parse and handle all the complete HTTP requests in the input buffer
+ */
+bool EpollConnection::processHTTP()
+{
+    while (!websocket && !closing && !closed) {
+
+        // Pipelined requests wait until the file of the previous one is sent
+        if (fileFD >= 0)
+            return input.length() <= MAX_HEADER_SIZE;
+
+        // Wait for the complete request headers
+        size_t end = input.find( "\r\n\r\n" );
+        if (end == string::npos)
+            return input.length() <= MAX_HEADER_SIZE;
+
+        // Parse the request line
+        size_t lineEnd = input.find( "\r\n" );
+        string requestLine = input.substr( 0, lineEnd );
+        size_t sp1 = requestLine.find( ' ' );
+        size_t sp2 = requestLine.rfind( ' ' );
+        if ((sp1 == string::npos) || (sp2 == sp1))
+            return false;
+        bool head = (requestLine.compare( 0, sp1, "HEAD" ) == 0);
+        string target = requestLine.substr( sp1+1, sp2-sp1-1 );
+        string version = requestLine.substr( sp2+1 );
+
+        // Parse the headers
+        headers.clear();
+        size_t pos = lineEnd + 2;
+        while (pos < end) {
+            size_t eol = input.find( "\r\n", pos );
+            size_t colon = input.find( ':', pos );
+            if ((colon != string::npos) && (colon < eol)) {
+                size_t valuePos = colon + 1;
+                while ((valuePos < eol) && (input[valuePos] == ' ' || input[valuePos] == '\t'))
+                    ++valuePos;
+                headers.push_back( make_pair( input.substr(pos, colon-pos), input.substr(valuePos, eol-valuePos) ) );
+            }
+            pos = eol + 2;
+        }
+
+        // Wait for the request body, which we do not use
+        size_t bodyLen = 0;
+        const char * contentLength = getHeader( "Content-Length" );
+        if (contentLength != NULL)
+            bodyLen = strtoul( contentLength, NULL, 10 );
+        if (bodyLen > MAX_HEADER_SIZE)
+            return false;
+        if (input.length() < end + 4 + bodyLen)
+            return true;
+        input.erase( 0, end + 4 + bodyLen );
+
+        // Keep only the decoded path of the URI
+        size_t query = target.find( '?' );
+        if (query != string::npos)
+            target = target.substr( 0, query );
+        uri = url_decode( target );
+
+        // Upgrade to websocket if requested
+        const char * upgrade = getHeader( "Upgrade" );
+        const char * key = getHeader( "Sec-WebSocket-Key" );
+        if ((upgrade != NULL) && (key != NULL) && (strcasecmp(upgrade, "websocket") == 0)) {
+            acceptWebsocket( key );
+            return input.empty() ? true : processWebsocket();
+        }
+
+        // Check if the connection is kept alive
+        const char * connection = getHeader( "Connection" );
+        bool keepAlive = (version == "HTTP/1.1");
+        if (connection != NULL) {
+            if (strcasecmp(connection, "close") == 0) keepAlive = false;
+            if (strcasecmp(connection, "keep-alive") == 0) keepAlive = true;
+        }
+
+        // Let the handler build the response
+        responseStatus = 200;
+        responseHeaders.clear();
+        responseBody.clear();
+        transport->handler->handleRequest( this );
+
+        // Send it with the length of the body and the file (a 304 has no body)
+        char statusLine[128];
+        if (responseStatus == 304) {
+            closeFile();
+            snprintf( statusLine, sizeof(statusLine), "HTTP/1.1 %d %s\r\n",
+                responseStatus, status_text(responseStatus) );
+        } else {
+            snprintf( statusLine, sizeof(statusLine), "HTTP/1.1 %d %s\r\nContent-Length: %llu\r\n",
+                responseStatus, status_text(responseStatus),
+                (unsigned long long)(responseBody.length() + fileRemaining) );
+        }
+        output += statusLine;
+        output += responseHeaders;
+        output += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+        // A HEAD request gets the headers of the GET response, without the body
+        if (head) {
+            closeFile();
+        } else {
+            output += responseBody;
+        }
+        responseHeaders.clear();
+        responseBody.clear();
+
+        if (!keepAlive)
+            closing = true;
+        handleWritable();
+
+    }
+    return true;
+}
+
+/**
+ * Upgrade the connection to a websocket
+ */
+void EpollConnection::acceptWebsocket( const char * key )
+{
+    // Calculate the accept key
+    unsigned char digest[20];
+    sha1( string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest );
+
+    // Send the handshake response
+    output += "HTTP/1.1 101 Switching Protocols\r\n"
+              "Upgrade: websocket\r\n"
+              "Connection: Upgrade\r\n"
+              "Sec-WebSocket-Accept: ";
+    output += base64_encode( digest, 20 );
+    output += "\r\n";
+
+    // Enable compression if the browser offers it
+    const char * extensions = getHeader( "Sec-WebSocket-Extensions" );
+    if (transport->deflateEnabled && (extensions != NULL)) {
+        string accepted = acceptDeflate( extensions );
+        if (!accepted.empty()) {
+            output += "Sec-WebSocket-Extensions: ";
+            output += accepted;
+            output += "\r\n";
+        }
+    }
+
+    output += "\r\n";
+    websocket = true;
+
+    // Websocket messages are small, don't let Nagle delay them
+    int flag = 1;
+    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag) );
+
+    transport->handler->handleWebsocketOpen( this );
+    handleWritable();
+}
+
+/**
+ * Negotiate permessage-deflate from the offered extensions
+ */
+string EpollConnection::acceptDeflate( const char * extensions )
+{
+#ifdef HAVE_ZLIB
+    // Walk the comma-separated offers and accept the first we can
+    string offers = extensions;
+    size_t pos = 0;
+    while (pos < offers.length()) {
+        size_t end = offers.find( ',', pos );
+        if (end == string::npos) end = offers.length();
+        string offer = offers.substr( pos, end-pos );
+        pos = end + 1;
+
+        // Split the offer in it's ';'-separated parameters
+        vector< string > params;
+        size_t p = 0;
+        while (p <= offer.length()) {
+            size_t e = offer.find( ';', p );
+            if (e == string::npos) e = offer.length();
+            string param = offer.substr( p, e-p );
+            size_t a = param.find_first_not_of( " \t" );
+            size_t b = param.find_last_not_of( " \t" );
+            params.push_back( (a == string::npos) ? string() : param.substr(a, b-a+1) );
+            p = e + 1;
+        }
+        if (params.empty() || (params[0] != "permessage-deflate"))
+            continue;
+
+        // Check the parameters
+        bool noContext = false, valid = true;
+        int windowBits = 15;
+        string response = "permessage-deflate";
+        for (size_t i=1; i<params.size(); ++i) {
+            const string & param = params[i];
+            if (param == "server_no_context_takeover") {
+                noContext = true;
+                response += "; server_no_context_takeover";
+            } else if (param.compare(0, 22, "server_max_window_bits") == 0) {
+                size_t eq = param.find( '=' );
+                windowBits = (eq == string::npos) ? 0 : atoi( param.c_str() + eq + 1 );
+                if ((windowBits < 8) || (windowBits > 15)) { valid = false; break; }
+                // The reply must not exceed the offer (RFC 7692)
+                response += "; server_max_window_bits=" + to_string(windowBits);
+                // zlib can't produce raw streams with 8-bit windows, but with
+                // 9 bits it never refers back more than 250 bytes, so the
+                // stream is still valid for a 256-byte window
+                if (windowBits == 8) windowBits = 9;
+            } else if ((param == "client_no_context_takeover") || (param.compare(0, 22, "client_max_window_bits") == 0)) {
+                // Our inflater uses the largest window, so it accepts anything
+            } else if (!param.empty()) {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid)
+            continue;
+
+        // Create the compression streams
+        deflater = new z_stream();
+        if (deflateInit2( deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY ) != Z_OK) {
+            delete deflater;
+            deflater = NULL;
+            return "";
+        }
+        inflater = new z_stream();
+        if (inflateInit2( inflater, -15 ) != Z_OK) {
+            delete inflater;
+            inflater = NULL;
+            deflateEnd( deflater );
+            delete deflater;
+            deflater = NULL;
+            return "";
+        }
+        deflateNoContext = noContext;
+        return response;
+    }
+#endif
+    return "";
+}
+
+/**
+ * Compress a message, keeping the context for the next one
+ */
+bool EpollConnection::deflateMessage( const char * data, size_t len, string & out )
+{
+#ifdef HAVE_ZLIB
+    char buf[16384];
+    deflater->next_in = (Bytef *)data;
+    deflater->avail_in = len;
+
+    // Flush everything, ending on a byte boundary
+    do {
+        deflater->next_out = (Bytef *)buf;
+        deflater->avail_out = sizeof(buf);
+        if (deflate( deflater, Z_SYNC_FLUSH ) == Z_STREAM_ERROR)
+            return false;
+        out.append( buf, sizeof(buf) - deflater->avail_out );
+    } while (deflater->avail_out == 0);
+
+    // The sync flush marker is implied by the receiver
+    if ((out.length() >= 4) && (out.compare( out.length()-4, 4, "\x00\x00\xff\xff", 4 ) == 0))
+        out.resize( out.length()-4 );
+
+    if (deflateNoContext)
+        deflateReset( deflater );
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Decompress a message, keeping the context for the next one
+ */
+bool EpollConnection::inflateMessage( const string & data, string & out )
+{
+#ifdef HAVE_ZLIB
+    if (inflater == NULL)
+        return false;
+
+    // Put back the sync flush marker
+    string in = data;
+    in.append( "\x00\x00\xff\xff", 4 );
+
+    char buf[16384];
+    inflater->next_in = (Bytef *)in.data();
+    inflater->avail_in = in.length();
+    do {
+        inflater->next_out = (Bytef *)buf;
+        inflater->avail_out = sizeof(buf);
+        int ans = inflate( inflater, Z_SYNC_FLUSH );
+        if ((ans != Z_OK) && (ans != Z_BUF_ERROR) && (ans != Z_STREAM_END))
+            return false;
+        out.append( buf, sizeof(buf) - inflater->avail_out );
+        if (out.length() > MAX_MESSAGE_SIZE)
+            return false;
+    } while (inflater->avail_out == 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Parse and handle all the complete websocket frames in the input buffer
+ */
+bool EpollConnection::processWebsocket()
+{
+    const unsigned char * buf = (const unsigned char *)input.data();
+    size_t consumed = 0;
+    bool ok = true;
+
+    while (!closing && !closed) {
+        size_t avail = input.length() - consumed;
+        const unsigned char * p = buf + consumed;
+
+        // Parse the frame header
+        if (avail < 2) break;
+        bool fin = (p[0] & 0x80) != 0;
+        bool compressed = (p[0] & 0x40) != 0;
+        int opcode = p[0] & 0x0F;
+        bool masked = (p[1] & 0x80) != 0;
+        uint64_t len = p[1] & 0x7F;
+        size_t pos = 2;
+        if (len == 126) {
+            if (avail < 4) break;
+            len = ((uint64_t)p[2] << 8) | p[3];
+            pos = 4;
+        } else if (len == 127) {
+            if (avail < 10) break;
+            len = 0;
+            for (int i=0; i<8; ++i)
+                len = (len << 8) | p[2+i];
+            pos = 10;
+        }
+        if (len > MAX_MESSAGE_SIZE) { ok = false; break; }
+        unsigned char mask[4] = { 0, 0, 0, 0 };
+        if (masked) {
+            if (avail < pos + 4) break;
+            memcpy( mask, p + pos, 4 );
+            pos += 4;
+        }
+
+        // Wait for the complete payload
+        if (avail < pos + len) break;
+        string payload( (const char *)p + pos, (size_t)len );
+        if (masked) {
+            for (size_t i=0; i<payload.length(); ++i)
+                payload[i] ^= mask[i % 4];
+        }
+        consumed += pos + len;
+
+        if (opcode & 0x08) {
+
+            // Control frames
+            if (opcode == 0x08) {
+                // Echo the status code and close
+                sendFrame( 0x08, payload.data(), payload.length() < 2 ? payload.length() : 2 );
+                closing = true;
+                handleWritable();
+            } else if (opcode == 0x09) {
+                sendFrame( 0x0A, payload.data(), payload.length() );
+            }
+
+        } else {
+
+            // Reassemble fragmented messages. Only the first
+            // fragment carries the compression flag.
+            if (opcode != 0x00) {
+                fragmentOpcode = opcode;
+                fragmentCompressed = compressed;
+                fragment.swap( payload );
+            } else {
+                fragment += payload;
+                if (fragment.length() > MAX_MESSAGE_SIZE) { ok = false; break; }
+            }
+            if (fin) {
+                if (fragmentCompressed) {
+                    string message;
+                    if (!inflateMessage( fragment, message )) { ok = false; break; }
+                    fragment.swap( message );
+                }
+                if (!transport->handler->handleWebsocketFrame( this, fragmentOpcode, fragment.data(), fragment.length() ))
+                    close();
+                fragment.clear();
+            }
+
+        }
+
+    }
+
+    input.erase( 0, consumed );
+    return ok;
+}
+
+/**
+ * Create the listening socket and the epoll instance
+ */
+EpollTransport::EpollTransport( ConfigPtr config, TransportHandler * handler )
+    : handler(handler), deflateEnabled(config->websocketDeflate), deflateThreshold(config->websocketDeflateThreshold),
+      epollFD(-1), listenFD(-1), wakeupFD(-1), spareFD(-1), closedConnections(), openConnections()
+{
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof(ev) );
+
+    // Create the epoll instance and the wakeup event
+    epollFD = epoll_create1( EPOLL_CLOEXEC );
+    wakeupFD = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &wakeupFD;
+    epoll_ctl( epollFD, EPOLL_CTL_ADD, wakeupFD, &ev );
+
+    // Listen on the loopback interface
+    listenFD = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    int flag = 1;
+    setsockopt( listenFD, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag) );
+
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons( config->webserverPort );
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if ((bind( listenFD, (struct sockaddr *)&addr, sizeof(addr) ) != 0) || (listen( listenFD, SOMAXCONN ) != 0)) {
+        ::close( listenFD );
+        listenFD = -1;
+        return;
+    }
+
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &listenFD;
+    epoll_ctl( epollFD, EPOLL_CTL_ADD, listenFD, &ev );
+
+    // Keep a descriptor in reserve for acceptConnections()
+    spareFD = open( "/dev/null", O_RDONLY | O_CLOEXEC );
+}
+
+/**
+ * Close all the sockets
+ */
+EpollTransport::~EpollTransport()
+{
+    releaseClosed();
+
+    // Release the connections still open
+    for (unordered_set< EpollConnection* >::iterator it=openConnections.begin(); it!=openConnections.end(); ++it)
+        (*it)->markClosed();
+    releaseClosed();
+
+    if (listenFD >= 0) ::close( listenFD );
+    if (wakeupFD >= 0) ::close( wakeupFD );
+    if (spareFD >= 0) ::close( spareFD );
+    if (epollFD >= 0) ::close( epollFD );
+}
+
+/**
+ * Accept all the pending connections
+ */
+void EpollTransport::acceptConnections()
+{
+    for (;;) {
+        int fd = accept4( listenFD, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if (fd < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) break;
+
+            // Aborted connections only affect themselves
+            if ((errno == EINTR) || (errno == ECONNABORTED) || (errno == EPROTO)) continue;
+
+            // Out of descriptors. The listener is edge-triggered, so the
+            // backlog must be drained: free the spare descriptor to accept
+            // the connection, drop it and take the spare back.
+            if (((errno == EMFILE) || (errno == ENFILE)) && (spareFD >= 0)) {
+                ::close( spareFD );
+                fd = accept4( listenFD, NULL, NULL, SOCK_CLOEXEC );
+                int error = errno;
+                if (fd >= 0) ::close( fd );
+                spareFD = open( "/dev/null", O_RDONLY | O_CLOEXEC );
+                if (fd >= 0) continue;
+                if ((error == EAGAIN) || (error == EWOULDBLOCK)) break;
+            }
+
+            // Out of memory or without a spare descriptor, the connections
+            // stay in the backlog. Try again on the next poll.
+            rearmListener();
+            break;
+        }
+
+        // Register the socket, once for both directions
+        EpollConnection * conn = new EpollConnection( this, fd );
+        struct epoll_event ev;
+        memset( &ev, 0, sizeof(ev) );
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl( epollFD, EPOLL_CTL_ADD, fd, &ev ) != 0) {
+            ::close( fd );
+            delete conn;
+            continue;
+        }
+        openConnections.insert( conn );
+    }
+}
+
+/**
+ * Ask epoll to report the listening socket again
+ */
+void EpollTransport::rearmListener()
+{
+    // Modifying an edge-triggered descriptor reports it again if it's ready
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof(ev) );
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &listenFD;
+    epoll_ctl( epollFD, EPOLL_CTL_MOD, listenFD, &ev );
+}
+
+/**
+ * Release all the connections marked as closed
+ */
+void EpollTransport::releaseClosed()
+{
+    // The handler might close more connections
+    while (!closedConnections.empty()) {
+        EpollConnection * conn = closedConnections.back();
+        closedConnections.pop_back();
+
+        if (conn->websocket)
+            handler->handleClose( conn );
+        openConnections.erase( conn );
+        ::close( conn->fd );
+        delete conn;
+    }
+}
+
+/**
+ * Wait for socket events and handle them
+ */
+void EpollTransport::poll( int timeout )
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    // Connections closed since the last poll are released first
+    releaseClosed();
+
+    int n = epoll_wait( epollFD, events, MAX_EVENTS, timeout );
+    for (int i=0; i<n; ++i) {
+        void * ptr = events[i].data.ptr;
+
+        if (ptr == &wakeupFD) {
+
+            // Drain the wakeup counter
+            uint64_t value;
+            while (::read( wakeupFD, &value, sizeof(value) ) > 0) { };
+
+        } else if (ptr == &listenFD) {
+            acceptConnections();
+
+        } else {
+
+            // Connections closed by a previous event are skipped
+            EpollConnection * conn = static_cast<EpollConnection*>(ptr);
+            if (conn->closed) continue;
+
+            if (events[i].events & EPOLLOUT) {
+                bool backlog = conn->getPendingBytes() > 0;
+                conn->handleWritable();
+
+                // Let the handler send what it held back
+                if (backlog && conn->websocket && !conn->closing && !conn->closed && (conn->getPendingBytes() == 0))
+                    handler->handleWritable( conn );
+
+                // Handle the pipelined requests that waited for a file
+                if (backlog && !conn->websocket && !conn->closed && (conn->getPendingBytes() == 0) && !conn->input.empty()) {
+                    if (!conn->processHTTP())
+                        conn->markClosed();
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+                conn->handleReadable();
+            if (events[i].events & EPOLLERR)
+                conn->markClosed();
+
+        }
+    }
+
+    // Release the connections closed during this poll
+    releaseClosed();
+}
+
+/**
+ * Interrupt a waiting poll(), from any thread
+ */
+void EpollTransport::wakeup()
+{
+    uint64_t value = 1;
+    ssize_t ans = ::write( wakeupFD, &value, sizeof(value) );
+    (void)ans;
+}
+
+#endif /* __linux__ */
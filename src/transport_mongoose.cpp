@@ -0,0 +1,279 @@
+/**
+ * This file is part of the MarbleBar Library.
+ *
+ * libMarbleBar is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libMarbleBar is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libMarbleBar. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Developed by Ioannis Charalampidis 2015
+ * Contact: <ioannis.charalampidis[at]cern.ch>
+ */
+
+#include "marblebar/server/transport_mongoose.hpp"
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace mb;
+
+/**
+ * How many bytes of a file are kept in the mongoose send buffer
+ */
+#define FILE_SEND_WINDOW    262144
+
+/**
+ * Return the URI of the request
+ */
+const char * MongooseConnection::getURI()
+{
+    return conn->uri;
+}
+
+/**
+ * Return the value of a request header
+ */
+const char * MongooseConnection::getHeader( const char * name )
+{
+    return mg_get_header( conn, name );
+}
+
+/**
+ * Set the status code of the HTTP response
+ */
+void MongooseConnection::sendStatus( int code )
+{
+    mg_send_status( conn, code );
+}
+
+/**
+ * Add a header to the HTTP response
+ */
+void MongooseConnection::sendHeader( const char * name, const char * value )
+{
+    mg_send_header( conn, name, value );
+}
+
+/**
+ * Append data to the body of the HTTP response
+ */
+void MongooseConnection::sendData( const char * data, size_t len )
+{
+    // An empty chunk would end the response
+    if (len == 0) return;
+    mg_send_data( conn, data, len );
+    dataSent = true;
+}
+
+/**
+ * Close the file still being sent, if any
+ */
+MongooseConnection::~MongooseConnection()
+{
+    if (fileFD >= 0)
+        ::close( fileFD );
+}
+
+/**
+ * Append a file region to the body of the HTTP response. Mongoose has
+ * no zero-copy path for this, so the file is copied in chunks, as the
+ * send buffer drains (see sendFileChunks).
+ */
+void MongooseConnection::sendFile( int fd, off_t offset, size_t len )
+{
+    if ((len == 0) || (lseek( fd, offset, SEEK_SET ) != offset)) {
+        ::close( fd );
+        return;
+    }
+    fileFD = fd;
+    fileRemaining = len;
+    dataSent = true;
+}
+
+/**
+ * Send the next part of the file of the response
+ */
+bool MongooseConnection::sendFileChunks()
+{
+    if (fileFD < 0)
+        return true;
+
+    // Mongoose returns the bytes waiting in it's send buffer
+    char buf[65536];
+    size_t buffered = mg_write( conn, "", 0 );
+    while ((fileRemaining > 0) && (buffered < FILE_SEND_WINDOW)) {
+        int n = read( fileFD, buf, (fileRemaining > sizeof(buf)) ? sizeof(buf) : fileRemaining );
+        if (n <= 0) break;
+        buffered = mg_send_data( conn, buf, n );
+        fileRemaining -= n;
+    }
+
+    // Wait for the buffer to drain, unless the file is over (or failed)
+    if ((fileRemaining > 0) && (buffered >= FILE_SEND_WINDOW))
+        return false;
+    ::close( fileFD );
+    fileFD = -1;
+    return true;
+}
+
+/**
+ * Send a websocket frame
+ */
+void MongooseConnection::sendFrame( int opcode, const char * data, size_t len )
+{
+    mg_websocket_write( conn, opcode, data, len );
+}
+
+/**
+ * Close the socket
+ */
+void MongooseConnection::close()
+{
+    // Send Connection Close Frame, mongoose drops the
+    // connection when the browser replies
+    if (!closing)
+        mg_websocket_write( conn, 0x08, NULL, 0 );
+    closing = true;
+}
+
+/**
+ * Mongoose buffers everything internally, so the socket always looks drained
+ */
+size_t MongooseConnection::getPendingBytes()
+{
+    return 0;
+}
+
+/**
+ * Raw event handler
+ */
+int MongooseTransport::ev_handler(struct mg_connection *conn, enum mg_event ev) 
+{
+
+    // Fetch 'this' from the connection server object
+    MongooseTransport* self = static_cast<MongooseTransport*>(conn->server_param);
+
+    if (ev == MG_REQUEST) {
+
+        // Plain HTTP requests are served right away
+        if (!conn->is_websocket) {
+            MongooseConnection * c = new MongooseConnection( conn );
+            self->handler->handleRequest( c );
+
+            // Mongoose ends the headers only when data are sent
+            if (!c->dataSent)
+                mg_printf( conn, "Content-Length: 0\r\n\r\n" );
+
+            // Files are sent in chunks on the next polls, as the buffer drains
+            if (!c->sendFileChunks()) {
+                conn->connection_param = c;
+                return MG_MORE;
+            }
+            delete c;
+            return MG_TRUE;
+        }
+
+        // Websockets keep their connection object for their lifetime
+        MongooseConnection * c = static_cast<MongooseConnection*>(conn->connection_param);
+        if (c == NULL) {
+            c = new MongooseConnection( conn );
+            conn->connection_param = c;
+            self->handler->handleWebsocketOpen( c );
+        }
+
+        // Handle the frame
+        if (!self->handler->handleWebsocketFrame( c, conn->wsbits & 0x0F, conn->content, conn->content_len ))
+            return MG_FALSE;
+        return c->closing ? MG_FALSE : MG_TRUE;
+
+    } else if ((ev == MG_POLL) && !conn->is_websocket) {
+
+        // Continue sending the file of a response
+        MongooseConnection * c = static_cast<MongooseConnection*>(conn->connection_param);
+        if ((c == NULL) || !c->sendFileChunks())
+            return MG_FALSE;
+        conn->connection_param = NULL;
+        delete c;
+        return MG_TRUE;
+
+    } else if (ev == MG_CLOSE) {
+
+        // Release the connection object, of a websocket or of an
+        // HTTP response closed before it's file was sent
+        MongooseConnection * c = static_cast<MongooseConnection*>(conn->connection_param);
+        if (c != NULL) {
+            if (conn->is_websocket)
+                self->handler->handleClose( c );
+            conn->connection_param = NULL;
+            delete c;
+        }
+        return MG_TRUE;
+
+    } else if (ev == MG_AUTH) {
+        return MG_TRUE;
+    } else {
+        return MG_FALSE;
+    }
+}
+
+/**
+ * Callback used only to interrupt the server poll
+ */
+int MongooseTransport::wakeup_callback(struct mg_connection *conn, enum mg_event ev) 
+{
+    return MG_TRUE;
+}
+
+/**
+ * Create a mongoose server and setup listening port
+ */
+MongooseTransport::MongooseTransport( ConfigPtr config, TransportHandler * handler )
+    : handler(handler)
+{
+
+    // Create a mongoose server, passing the pointer
+    // of this class, in order for the C callbacks
+    // to have access to the class instance.
+    server = mg_create_server( this, MongooseTransport::ev_handler );
+
+    // Prepare the listening endpoint info
+    ostringstream ss; ss << "127.0.0.1:" << config->webserverPort;
+    mg_set_option(server, "listening_port", ss.str().c_str());
+
+}
+
+/**
+ * Destroy the mongoose server
+ */
+MongooseTransport::~MongooseTransport()
+{
+    mg_destroy_server( &server );
+}
+
+/**
+ * Poll server for incoming events
+ */
+void MongooseTransport::poll( int timeout )
+{
+    mg_poll_server( server, timeout );
+}
+
+/**
+ * Interrupt a waiting poll()
+ */
+void MongooseTransport::wakeup()
+{
+    mg_wakeup_server_ex( server, MongooseTransport::wakeup_callback, "" );
+}
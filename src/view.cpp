@@ -19,14 +19,45 @@
  */
 
 #include "marblebar/view.hpp"
-#include <sstream>
+#include <stdio.h>
+#include <algorithm>
 using namespace mb;
 
+/**
+ * Format a view or property ID to it's string form
+ */
+string mb::formatUIID( char prefix, unsigned int id )
+{
+	char buf[16];
+	snprintf( buf, sizeof(buf), "%c%u", prefix, id );
+	return buf;
+}
+
+/**
+ * Parse the string form of a view or property ID
+ */
+bool mb::parseUIID( char prefix, const string & str, unsigned int & id )
+{
+	if ((str.length() < 2) || (str.length() > 11) || (str[0] != prefix))
+		return false;
+	unsigned long long value = 0;
+	for (size_t i=1; i<str.length(); ++i) {
+		if ((str[i] < '0') || (str[i] > '9'))
+			return false;
+		value = value * 10 + (str[i] - '0');
+	}
+	if (value > 0xFFFFFFFFull)
+		return false;
+	id = (unsigned int)value;
+	return true;
+}
+
 /**
  * Marblebar View constructor
  */
 View::View( const string & title ) : 
-	attached(false), id(""), propertyGroups(), metadata(), lastPropertyID(0)
+	attached(false), id(0), propertyGroups(), properties(), metadata(),
+	specsVersion(1), specsFrameVersion(0), specsFrame(), specsMutex()
 {
 	metadata["title"] = title;
 }
@@ -39,6 +70,7 @@ PropertyGroupPtr View::group( const string& title )
 	// Create if missing
 	if (propertyGroups.find(title) == propertyGroups.end()) {
 		propertyGroups[title] = make_shared<PropertyGroup>( title, shared_from_this() );
+		invalidateSpecs();
 	}
 	// Return
 	return propertyGroups[title];
@@ -47,7 +79,7 @@ PropertyGroupPtr View::group( const string& title )
 /**
  * Marblebar View constructor
  */
-void View::attach( const KernelPtr& kernel, const string& id )
+void View::attach( const KernelPtr& kernel, unsigned int id )
 {
 	this->kernel = kernel;
 	this->id = id;
@@ -61,6 +93,7 @@ ViewPtr View::meta( const string & property, const Json::Value & value )
 {
 	// Update property
 	metadata[property] = value;
+	invalidateSpecs();
 	// Return instance for chaining calls
 	return shared_from_this();
 }
@@ -73,8 +106,8 @@ void View::markPropertyAsDirty( const PropertyPtr & property )
 	// Do not do anything unless attached
 	if (!this->attached) return;
 
-	// Broadcast to the kerne
-	kernel->broadcastViewPropertyUpdate( shared_from_this(), property );
+	// Let the kernel flush it on the next poll
+	kernel->markPropertyAsDirty( property );
 
 }
 
@@ -88,7 +121,7 @@ Json::Value View::getUISpecs()
 
 	// Get View ID
 	Json::Value value, specs, groups;
-	value["id"] = id;
+	value["id"] = formatUIID( 'v', id );
 
 	// Iterate over property groups
 	for (auto it = propertyGroups.begin(); it != propertyGroups.end(); ++it) {
@@ -108,33 +141,107 @@ Json::Value View::getUISpecs()
 	return value;
 }
 
+/**
+ * Return the cached view/add frame, encoding it if the view changed
+ */
+EgressFramePtr View::getSpecsFrame()
+{
+	std::unique_lock<std::mutex> lock(specsMutex);
+	unsigned long version = specsVersion.load();
+	if (!specsFrame || (specsFrameVersion != version)) {
+		specsFrame = WebserverConnection::buildAction( "view/add", getUISpecs() );
+		specsFrameVersion = version;
+	}
+	return specsFrame;
+}
 
 /**
- * Calculate and return the next property ID
+ * Mark the UI specifications as changed
  */
-string View::getNextPropertyID()
+void View::invalidateSpecs()
 {
-	// Compose view ID 
-	ostringstream oss;
-	oss << "p" << (++lastPropertyID);
-	// Return view-index
-	return oss.str();
+	++specsVersion;
+}
+
+/**
+ * Get the UI values of the specified view properties
+ */
+Json::Value View::getUIValues( const vector< PropertyPtr > & properties )
+{
+	// Collect all the property values
+	Json::Value value, props(Json::arrayValue);
+	for (auto it = properties.begin(); it != properties.end(); ++it) {
+		Json::Value prop;
+		prop["prop"] = formatUIID( 'p', (*it)->id );
+		prop["value"] = (*it)->getUIValue();
+		props.append( prop );
+	}
+
+	value["id"] = formatUIID( 'v', id );
+	value["props"] = props;
+	return value;
 }
 
 /**
  * Return a property by it's ID
  */
+PropertyPtr View::propertyById( unsigned int id )
+{
+	if (id >= properties.size())
+		return PropertyPtr();
+	return properties[id];
+}
+
+/**
+ * Return a property by the string form of it's ID
+ */
 PropertyPtr View::propertyById( const string& id )
 {
-	// Iterate over property groups
+	unsigned int index;
+	if (!parseUIID( 'p', id, index ))
+		return PropertyPtr();
+	return propertyById( index );
+}
+
+/**
+ * Attach a new property to the view, using it's index as ID
+ */
+void View::registerProperty( const PropertyPtr& property, const string & groupTitle )
+{
+	properties.push_back( property );
+	property->attach( shared_from_this(), properties.size() - 1 );
+	invalidateSpecs();
+
+	// Let the sessions create just this widget
+	if (this->attached)
+		kernel->broadcastPropertyAdded( shared_from_this(), property, groupTitle );
+}
+
+/**
+ * Remove a property from the view, leaving it's slot empty
+ */
+void View::removeProperty( const PropertyPtr& property )
+{
+	// Make sure it's ours
+	if ((property->view.get() != this) || (propertyById( property->id ) != property))
+		return;
+
+	// Remove from it's group
 	for (auto it = propertyGroups.begin(); it != propertyGroups.end(); ++it) {
-		// Iterate over their properties
-		for (auto jt = (*it).second->properties.begin(); jt != (*it).second->properties.end(); ++jt) {
-			// Compare IDs
-			if ((*jt)->id == id)
-				return *jt;
+		vector< PropertyPtr > & props = (*it).second->properties;
+		auto jt = find( props.begin(), props.end(), property );
+		if (jt != props.end()) {
+			props.erase( jt );
+			break;
 		}
 	}
-	// Return nothing
-	return PropertyPtr();
+
+	// Keep the IDs of the other properties
+	properties[property->id].reset();
+	property->detach();
+	invalidateSpecs();
+
+	// Let the sessions remove just this widget
+	if (this->attached)
+		kernel->broadcastPropertyRemoved( shared_from_this(), property );
 }
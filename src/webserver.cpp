@@ -19,48 +19,79 @@
  */
 
 #include "marblebar/server/webserver.hpp"
+#include "marblebar/server/embedded_files.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 
 using namespace mb;
 
 /**
- * This function is generated at build-time and contains the static resources
+ * MIME types of the embedded resources
  */
-extern const char *find_embedded_file(const string&, size_t *);
+static const struct {
+    const char * extension;
+    const char * mimeType;
+} mime_types[] = {
+    { ".html",  "text/html" },
+    { ".htm",   "text/html" },
+    { ".css",   "text/css" },
+    { ".js",    "application/javascript" },
+    { ".json",  "application/json" },
+    { ".png",   "image/png" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".gif",   "image/gif" },
+    { ".svg",   "image/svg+xml" },
+    { ".ico",   "image/x-icon" },
+    { ".woff",  "application/font-woff" },
+    { ".woff2", "font/woff2" },
+    { ".ttf",   "application/x-font-ttf" },
+    { ".eot",   "application/vnd.ms-fontobject" },
+    { ".otf",   "font/opentype" },
+    { ".txt",   "text/plain" },
+    { NULL,     NULL }
+};
 
 /**
- * Send an error message
+ * Return the MIME type of the given file
  */
-int send_error( struct mg_connection *conn, const char* message, const int code = 500 ) 
+static const char * get_mime_type( const char * url, size_t urlLen, const char * defaultType )
 {
-
-    // Send error code
-    mg_send_status(conn, code);
-
-    // Send payload
-    mg_printf_data( conn, 
-        "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<title>CernVM WebAPI :: Error</title>\n</head>\n"
-        "<body><h1>CernVM WebAPI Error %i</h1><p>%s</p></body>"
-        "</html>", code, message );
-
-    // Request processed
-    return MG_TRUE;
-
+    const char * dot = url + urlLen;
+    while ((dot > url) && (*(dot-1) != '.') && (*(dot-1) != '/')) --dot;
+    if ((dot == url) || (*(dot-1) != '.'))
+        return defaultType;
+    --dot;
+    size_t extLen = url + urlLen - dot;
+    for (int i=0; mime_types[i].extension != NULL; ++i) {
+        if ((strlen(mime_types[i].extension) == extLen) && (memcmp(dot, mime_types[i].extension, extLen) == 0))
+            return mime_types[i].mimeType;
+    }
+    return defaultType;
 }
 
 /**
- * This is the entry point for the CernVM Web API I/O
+ * Extract the domain from the 'Origin' header
  */
-int Webserver::api_handler(struct mg_connection *conn) 
+static string get_domain( TransportConnection * conn )
 {
-
-	// Fetch 'this' from the connection server object
-	Webserver* self = static_cast<Webserver*>(conn->server_param);
-
-    // Try to identify domain by the 'Origin' header
-    const char * c_origin = mg_get_header(conn, "Origin");
+    const char * c_origin = conn->getHeader("Origin");
     string domain = ""; 
     if (c_origin != NULL) {
     	domain=c_origin;
@@ -73,157 +104,430 @@ int Webserver::api_handler(struct mg_connection *conn)
             domain = domain.substr( 0, colonPos );
         }
     }
+    return domain;
+}
 
-    // Move URI to std::string
-    std::string url = conn->uri;
-
-    // DEBUG response
-    if (conn->is_websocket) {
-
-        // Check if a connection is active
-        WebserverConnectionPtr c;
-        if (self->connections.find(conn) == self->connections.end()) {
-	        unique_lock<mutex> objectLock(self->connMutex, std::try_to_lock);
-
-            // Initialize a new connection if such connection
-            // does not exist.
-            c = self->openConnection(domain, url);
-            c->isIterated = true;
-            self->connections[conn] = c;
+/**
+ * Compare two strings of the given length ignoring the ASCII case
+ * (strncasecmp is not available everywhere)
+ */
+static bool equals_nocase( const char * a, const char * b, size_t len )
+{
+    for (size_t i=0; i<len; ++i) {
+        char ca = a[i], cb = b[i];
+        if ((ca >= 'A') && (ca <= 'Z')) ca += 'a' - 'A';
+        if ((cb >= 'A') && (cb <= 'Z')) cb += 'a' - 'A';
+        if (ca != cb)
+            return false;
+    }
+    return true;
+}
 
-        } else {
-            c = self->connections[conn];
+/**
+ * Return the quality value the 'Accept-Encoding' header gives to the
+ * given content coding, taking '*' into account, or 0 if not acceptable
+ */
+static float get_encoding_quality( const char * acceptEncoding, const char * coding )
+{
+    float quality = 0, wildcard = -1;
+    bool found = false;
+    const char * p = acceptEncoding;
+    while (*p) {
+
+        // Extract the next token up to ',' and it's parameters up to ';'
+        while ((*p == ' ') || (*p == '\t') || (*p == ',')) ++p;
+        const char * token = p;
+        while (*p && (*p != ',') && (*p != ';') && (*p != ' ') && (*p != '\t')) ++p;
+        size_t tokenLen = p - token;
+        float q = 1;
+        while (*p && (*p != ',')) {
+            if ((*p == 'q') && (p[1] == '=')) q = (float)atof( p + 2 );
+            ++p;
         }
-
-        // Handle TEXT frames 
-        if ( (conn->wsbits & 0x0F) == 0x01) {
-            self->activeConnection = c;
-            c->handleRawData(conn->content, conn->content_len);
-            self->activeConnection = WebserverConnectionPtr();
+        if (tokenLen == 0) continue;
+
+        // Keep the quality of the coding or of the wildcard
+        if ((tokenLen == strlen(coding)) && equals_nocase(token, coding, tokenLen)) {
+            quality = q;
+            found = true;
+        } else if ((tokenLen == 1) && (*token == '*')) {
+            wildcard = q;
         }
 
-        // Check if connection is closed
-        return c->isConnected() ? MG_TRUE : MG_FALSE;
+    }
+    if (!found && (wildcard >= 0))
+        return wildcard;
+    return quality;
+}
 
-    } else {
+/**
+ * Check if the 'If-None-Match' header lists the given quoted ETag,
+ * using the weak comparison
+ */
+static bool etag_matches( const char * ifNoneMatch, const char * etag )
+{
+    size_t etagLen = strlen(etag);
+    const char * p = ifNoneMatch;
+    while (*p) {
+        while ((*p == ' ') || (*p == '\t') || (*p == ',')) ++p;
+        if (*p == '*')
+            return true;
+        if ((p[0] == 'W') && (p[1] == '/'))
+            p += 2;
+        const char * token = p;
+        while (*p && (*p != ',') && (*p != ' ') && (*p != '\t')) ++p;
+        if (((size_t)(p - token) == etagLen) && (strncmp(token, etag, etagLen) == 0))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Send an error message
+ */
+void send_error( TransportConnection *conn, const char* message, const int code = 500 ) 
+{
 
-        // Trim trailing & heading slash from URL
-        if (url[url.length()-1] == '/')
-            url = url.substr(0, url.length()-1);
-        if (url[0] == '/')
-            url = url.substr(1, url.length()-1);
+    // Send error code
+    conn->sendStatus(code);
 
-        // Check for embedded resources
-        size_t res_size;
-        const char *res_buffer = find_embedded_file( url, &res_size);
-        if ( url == "info" ) {
+    // Send payload
+    ostringstream oss;
+    oss << "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n<title>CernVM WebAPI :: Error</title>\n</head>\n"
+        << "<body><h1>CernVM WebAPI Error " << code << "</h1><p>" << message << "</p></body>"
+        << "</html>";
+    string payload = oss.str();
+    conn->sendData( payload.c_str(), payload.length() );
 
-            // Enable CORS (important for allowing every website to contact us)
-            mg_send_header(conn, "Access-Control-Allow-Origin", "*" );
-            mg_printf_data(conn, "{\"status\":\"ok\",\"request\":\"%s\",\"domain\":\"%s\",\"version\":\"%s\"}", conn->uri, domain.c_str(), self->config->version.c_str());
-            return MG_TRUE;
+}
 
-        } else if (res_buffer == NULL) {
-            
-            // File not found
-            return send_error( conn, "File not found", 404);
+/**
+ * Parse a 'Range' header with a single byte range of a file with the given
+ * size. Returns 1 if the range is valid, 0 if it can't be satisfied, or -1
+ * if the header should be ignored (and the whole file sent).
+ */
+static int parse_range( const char * range, unsigned long long size, unsigned long long & first, unsigned long long & last )
+{
+    if (strncmp(range, "bytes=", 6) != 0)
+        return -1;
+    const char * p = range + 6;
+    char * end;
+
+    // Multiple ranges are not supported
+    if (strchr(p, ',') != NULL)
+        return -1;
+
+    if (*p == '-') {
+
+        // The last bytes of the file
+        if ((p[1] < '0') || (p[1] > '9'))
+            return -1;
+        unsigned long long suffix = strtoull( p + 1, &end, 10 );
+        if (*end != '\0')
+            return -1;
+        if ((suffix == 0) || (size == 0))
+            return 0;
+        first = (suffix >= size) ? 0 : size - suffix;
+        last = size - 1;
+        return 1;
 
-        } else {
+    }
 
-            // Get MIME type of the file to send and send header
-            const char * mimeType = mg_get_mime_type( url.c_str(), "text/plain" );
-            mg_send_header(conn, "Content-Type", mimeType );
+    // From the first byte up to the last, or to the end
+    if ((*p < '0') || (*p > '9'))
+        return -1;
+    first = strtoull( p, &end, 10 );
+    if (*end != '-')
+        return -1;
+    p = end + 1;
+    if (*p == '\0') {
+        last = size - 1;
+    } else {
+        if ((*p < '0') || (*p > '9'))
+            return -1;
+        last = strtoull( p, &end, 10 );
+        if ((*end != '\0') || (last < first))
+            return -1;
+        if (last >= size)
+            last = size - 1;
+    }
+    if (first >= size)
+        return 0;
+    return 1;
+}
 
-            // Send data
-            mg_send_data( conn, res_buffer, res_size );
-            return MG_TRUE;
+/**
+ * Send a file from the disk, with support for conditional and range requests
+ */
+static void send_file( TransportConnection * conn, const char * path )
+{
+    int fd = open( path, O_RDONLY | O_BINARY );
+    if (fd < 0) {
+        send_error( conn, "File not found", 404 );
+        return;
+    }
+    struct stat st;
+    if ((fstat( fd, &st ) != 0) || !S_ISREG(st.st_mode)) {
+        close( fd );
+        send_error( conn, "File not found", 404 );
+        return;
+    }
+    unsigned long long size = st.st_size;
+
+    // The validators come from the modification time and the size
+    char etag[64], lastModified[64];
+    snprintf( etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)st.st_mtime, size );
+    strftime( lastModified, sizeof(lastModified), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&st.st_mtime) );
+
+    // Check if the copy of the browser is still valid
+    const char * ifNoneMatch = conn->getHeader("If-None-Match");
+    const char * ifModifiedSince = conn->getHeader("If-Modified-Since");
+    bool notModified = (ifNoneMatch != NULL) ? etag_matches( ifNoneMatch, etag )
+                     : ((ifModifiedSince != NULL) && (strcmp(ifModifiedSince, lastModified) == 0));
+
+    // Apply the range, unless 'If-Range' refers to another version of the file
+    unsigned long long first = 0, last = size - 1;
+    int range = -1;
+    const char * rangeHeader = conn->getHeader("Range");
+    const char * ifRange = conn->getHeader("If-Range");
+    if (!notModified && (rangeHeader != NULL) &&
+        ((ifRange == NULL) || (strcmp(ifRange, etag) == 0) || (strcmp(ifRange, lastModified) == 0)))
+        range = parse_range( rangeHeader, size, first, last );
+
+    if (notModified) {
+        conn->sendStatus(304);
+    } else if (range == 0) {
+        conn->sendStatus(416);
+    } else if (range == 1) {
+        conn->sendStatus(206);
+    }
 
-        }
+    // Files on the disk can change at any time, so they are always revalidated
+    conn->sendHeader("ETag", etag );
+    conn->sendHeader("Last-Modified", lastModified );
+    conn->sendHeader("Cache-Control", "no-cache" );
+    conn->sendHeader("Accept-Ranges", "bytes" );
+    if (notModified) {
+        close( fd );
+        return;
+    }
 
-	    
+    char contentRange[128];
+    if (range == 0) {
+        close( fd );
+        snprintf( contentRange, sizeof(contentRange), "bytes */%llu", size );
+        conn->sendHeader("Content-Range", contentRange );
+        return;
+    }
+    conn->sendHeader("Content-Type", get_mime_type( path, strlen(path), "application/octet-stream" ) );
+    if (range == 1) {
+        snprintf( contentRange, sizeof(contentRange), "bytes %llu-%llu/%llu", first, last, size );
+        conn->sendHeader("Content-Range", contentRange );
     }
-    return 1;
+
+    // The transport sends it straight from the file
+    conn->sendFile( fd, (off_t)first, (range == 1) ? (size_t)(last - first + 1) : (size_t)size );
 
 }
 
 /**
- * Iterator over the websocket connections
+ * Handle a plain HTTP request
  */
-int Webserver::iterate_callback(struct mg_connection *conn, enum mg_event ev) 
+void Webserver::handleRequest( TransportConnection * conn ) 
 {
 
-    // Fetch 'this' from the connection server object
-    Webserver* self = static_cast<Webserver*>(conn->callback_param);
-
-    // Handle websockets
-    if ((ev == MG_POLL) && conn->is_websocket) {
+    // Trim trailing & heading slash from URL, without copying it
+    const char * url = conn->getURI();
+    size_t urlLen = strlen(url);
+    if ((urlLen > 0) && (url[urlLen-1] == '/'))
+        --urlLen;
+    if ((urlLen > 0) && (url[0] == '/')) {
+        ++url;
+        --urlLen;
+    }
 
-        // Check if a WebserverConnectionPtr is active
-        WebserverConnectionPtr c;
-        if (self->connections.find(conn) == self->connections.end()) {
-            // This connection is not handled by us!
-            return MG_TRUE;
+    // Check for the info endpoint and then for embedded resources
+    const EmbeddedFile * res = NULL;
+    if ((urlLen == 4) && (memcmp(url, "info", 4) == 0)) {
+
+        // Enable CORS (important for allowing every website to contact us)
+        conn->sendHeader("Access-Control-Allow-Origin", "*" );
+        ostringstream oss;
+        oss << "{\"status\":\"ok\",\"request\":\"" << conn->getURI() << "\",\"domain\":\"" << get_domain(conn) 
+            << "\",\"version\":\"" << config->version << "\"}";
+        string payload = oss.str();
+        conn->sendData( payload.c_str(), payload.length() );
+
+    } else if ((res = findEmbeddedFile( url, urlLen )) != NULL) {
+
+        // Pick the smallest precompressed variant the client accepts
+        const unsigned char * data = res->data;
+        size_t size = res->size;
+        const char * etag = res->etag;
+        const char * encoding = NULL;
+        bool compressed = (res->gzip != NULL) || (res->brotli != NULL);
+        const char * acceptEncoding = conn->getHeader("Accept-Encoding");
+        if (compressed && (acceptEncoding != NULL)) {
+            if ((res->brotli != NULL) && (get_encoding_quality(acceptEncoding, "br") > 0)) {
+                encoding = "br";
+                data = res->brotli;
+                size = res->brotliSize;
+                etag = res->brotliETag;
+            } else if ((res->gzip != NULL) && (get_encoding_quality(acceptEncoding, "gzip") > 0)) {
+                encoding = "gzip";
+                data = res->gzip;
+                size = res->gzipSize;
+                etag = res->gzipETag;
+            }
+        }
 
+        // The embedded resources never change while we are running, so
+        // the browser cache is valid if it has the same variant
+        const char * ifNoneMatch = conn->getHeader("If-None-Match");
+        bool notModified = (ifNoneMatch != NULL) && etag_matches( ifNoneMatch, etag );
+        if (notModified)
+            conn->sendStatus(304);
+
+        // Send the caching headers
+        const char * mimeType = get_mime_type( url, urlLen, "text/plain" );
+        conn->sendHeader("ETag", etag );
+        if ((strcmp(mimeType, "text/html") == 0) || (config->staticMaxAge <= 0)) {
+            conn->sendHeader("Cache-Control", "no-cache" );
         } else {
-            c = self->connections[conn];
+            char cacheControl[64];
+            snprintf( cacheControl, sizeof(cacheControl), "public, max-age=%d", config->staticMaxAge );
+            conn->sendHeader("Cache-Control", cacheControl );
         }
+        if (compressed)
+            conn->sendHeader("Vary", "Accept-Encoding" );
+        if (notModified)
+            return;
+
+        // Send the content headers and the data
+        conn->sendHeader("Content-Type", mimeType );
+        if (encoding != NULL)
+            conn->sendHeader("Content-Encoding", encoding );
+        conn->sendData( (const char *)data, size );
 
-        // Mark socket as iterated
-        c->isIterated = true;
+    } else {
 
-        // Send all frames of the egress queue
-        std::string buf;
-        while ( !(buf = c->getEgressRawData()).empty() ) {
-            mg_websocket_write(conn, 0x01, buf.c_str(), buf.length());
+        // Then for the files served from the disk
+        string file;
+        {
+            std::unique_lock<std::mutex> lock(staticMutex);
+            if (!staticResources.empty()) {
+                auto it = staticResources.find( string(url, urlLen) );
+                if (it != staticResources.end())
+                    file = it->second;
+            }
+        }
+        if (file.empty()) {
+            send_error( conn, "File not found", 404);
+        } else {
+            send_file( conn, file.c_str() );
         }
 
-        // If we are disconnected, send disconnect frame
-        if (!c->isConnected()) {
+    }
 
-            // Send Connection Close Frame
-            mg_websocket_write(conn, 0x08, NULL, 0);
+}
 
-            // Mark as non-iterated so it's deleted on poll()
-            c->isIterated = false;
+/**
+ * Open the session of a new websocket
+ */
+void Webserver::handleWebsocketOpen( TransportConnection * conn ) 
+{
+    lock_guard<mutex> objectLock(connMutex);
+
+    // The origin is parsed only once, with the handshake
+    WebserverConnectionPtr c = openConnection( get_domain(conn), conn->getURI() );
+    c->server = this;
+    c->socket = conn;
+    c->conflate = (config->egressPolicy == EgressConflate);
+
+    // Keep it, and let the socket point back to it
+    c->connIndex = connections.size();
+    connections.push_back(c);
+    conn->handlerData = c.get();
+}
 
-        }
+/**
+ * Handle an incoming websocket frame
+ */
+bool Webserver::handleWebsocketFrame( TransportConnection * conn, int opcode, const char * data, size_t len ) 
+{
+
+    // Find the session of the socket
+    WebserverConnection * c = static_cast<WebserverConnection*>(conn->handlerData);
+    if (c == NULL)
+        return false;
+
+    // Handle TEXT frames 
+    if (opcode == 0x01) {
+        activeConnection = connections[c->connIndex];
+        c->handleRawData(data, len);
+        activeConnection = WebserverConnectionPtr();
 
+        // Send the responses right away
+        sendEgress();
     }
 
-    // We are done with
-    return MG_TRUE;
+    // Check if connection is closed
+    return c->isConnected();
 
 }
 
 /**
- * RAW Request handler
+ * Send what is left in the egress queue of a drained websocket
  */
-int Webserver::ev_handler(struct mg_connection *conn, enum mg_event ev) 
+void Webserver::handleWritable( TransportConnection * conn ) 
 {
-    if (ev == MG_REQUEST) {
-        return api_handler(conn);
-    } else if (ev == MG_AUTH) {
-        return MG_TRUE;
-    } else {
-        return MG_FALSE;
+    WebserverConnection * c = static_cast<WebserverConnection*>(conn->handlerData);
+    if (c != NULL)
+        c->sendEgress( config->egressSocketBuffer );
+}
+
+/**
+ * Release the session of a closed websocket
+ */
+void Webserver::handleClose( TransportConnection * conn ) 
+{
+    lock_guard<mutex> objectLock(connMutex);
+    WebserverConnection * c = static_cast<WebserverConnection*>(conn->handlerData);
+    if (c == NULL)
+        return;
+
+    // Forget the socket and any scheduled egress
+    WebserverConnectionPtr keep = connections[c->connIndex];
+    if (c->egressScheduled) {
+        for (auto jt = egressPending.begin(); jt != egressPending.end(); ++jt) {
+            if (*jt == c) {
+                egressPending.erase(jt);
+                break;
+            }
+        }
+        c->egressScheduled = false;
     }
+    c->socket = NULL;
+    c->server = NULL;
+    conn->handlerData = NULL;
+
+    // Release connection object, moving the last one in it's place
+    c->cleanup();
+    connections[c->connIndex] = connections.back();
+    connections[c->connIndex]->connIndex = c->connIndex;
+    connections.pop_back();
 }
 
 /**
  * Create a webserver and setup listening port
  */
 Webserver::Webserver( ConfigPtr config ) 
-    : config(config), staticResources(), connections(), activeConnection(), connMutex()
+    : running(false), stopping(false), connections(), activeConnection(), config(config), connMutex(), pollThread(), wakeupPending(false), 
+      egressPending(), egressDropped(0), egressConflated(0), egressDisconnects(0), transport(), staticResources(), staticMutex()
 {
 
-	// Create a mongoose server, passing the pointer
-	// of this class, in order for the C callbacks
-	// to have access to the class instance.
-	server = mg_create_server( this, Webserver::ev_handler );
-
-	// Prepare the listening endpoint info
-	ostringstream ss; ss << "127.0.0.1:" << config->webserverPort;
-    mg_set_option(server, "listening_port", ss.str().c_str());
+    // Create the socket backend selected in the config
+    transport = Transport::create( config, this );
 
 }
 
@@ -233,16 +537,17 @@ Webserver::Webserver( ConfigPtr config )
 Webserver::~Webserver() 
 {
 
-    // Destroy mongoose server
-    mg_destroy_server( &server );
+    // Destroy the transport, closing all the sockets
+    transport.reset();
 
 	// Destroy connections
     {
-        unique_lock<mutex> objectLock(connMutex, std::try_to_lock);
+        lock_guard<mutex> objectLock(connMutex);
 
-        std::map<mg_connection*, WebserverConnectionPtr>::iterator it;
-        for (it=connections.begin(); it!=connections.end(); ++it) {
-            WebserverConnectionPtr c = it->second;
+        for (auto it=connections.begin(); it!=connections.end(); ++it) {
+            WebserverConnectionPtr c = *it;
+            c->socket = NULL;
+            c->server = NULL;
             c->cleanup();
         }
 
@@ -259,8 +564,15 @@ Webserver::~Webserver()
 void Webserver::serve_static( const std::string& url, const std::string& file ) 
 {
 
-    // Store on staticResources
-    staticResources[url] = file;
+    // Store on staticResources, with the slashes trimmed like the requests
+    size_t first = url.find_first_not_of('/');
+    size_t last = url.find_last_not_of('/');
+    std::unique_lock<std::mutex> lock(staticMutex);
+    if (first == string::npos) {
+        staticResources[""] = file;
+    } else {
+        staticResources[url.substr(first, last - first + 1)] = file;
+    }
 
 }
 
@@ -271,51 +583,88 @@ void Webserver::serve_static( const std::string& url, const std::string& file )
 void Webserver::poll( const int timeout) 
 {
 
-    // Mark all the connections as 'not iterated'
-    {
-        unique_lock<mutex> objectLock(connMutex, std::try_to_lock);
-        std::map<mg_connection*, WebserverConnectionPtr>::iterator it;
-        for (it=connections.begin(); it!=connections.end(); ++it) {
-            WebserverConnectionPtr c = it->second;
-            c->isIterated = false;
-        }
-    }
+    // Keep track of the thread that polls the server
+    pollThread.store( this_thread::get_id(), memory_order_relaxed );
 
-    // Send the message to iterate over connections
-    mg_iterate_over_connections(server, Webserver::iterate_callback, this);
+    // Everything requested until now is handled by this poll, so
+    // any wakeup from now on must interrupt the server poll again
+    wakeupPending.store( false );
 
-	// Poll mongoose server
-    mg_poll_server(server, timeout);	
+    // Let subclasses flush their pending updates
+    int flushTimeout = flushUpdates();
 
-    // Find dead connections
-    {
-        unique_lock<mutex> objectLock(connMutex, std::try_to_lock);
-        std::map<mg_connection*, WebserverConnectionPtr>::iterator it;
-        for (it=connections.begin(); it!=connections.end(); ++it) {
-            WebserverConnectionPtr c = it->second;
+    // Send everything queued until now
+    sendEgress();
+
+    // Wait for socket events, but not past the next flush
+    if ((flushTimeout >= 0) && (flushTimeout < timeout)) {
+        transport->poll(flushTimeout);
+    } else {
+        transport->poll(timeout);
+    }
 
-            // Delete non-iterated over actions
-            if (!c->isIterated) {
+}
 
-                // Release connection object
-                c->cleanup();
+/**
+ * Apply the egress limits and schedule a connection with pending egress frames
+ */
+void Webserver::scheduleEgress( WebserverConnection * conn ) 
+{
+    // Count the property values replaced in the queue
+    if (conn->conflatedValues > 0) {
+        egressConflated += conn->conflatedValues;
+        conn->conflatedValues = 0;
+    }
 
-                // Delete element
-                connections.erase(it);
+    // Keep slow consumers within the limits
+    if (conn->isEgressFull( config->egressMaxFrames, config->egressMaxBytes )) {
+        switch (config->egressPolicy) {
 
-                // Skip deleted element or exit
-                if (connections.empty()) {
-                    break;
-                    
-                } else {
-                    // Otherwise rewind pointer
-                    it = connections.begin();
-                }
+            case EgressConflate:
+                // The values are already conflated, so there are
+                // too many other frames. Drop the oldest.
+
+            case EgressDropOldest:
+                egressDropped += conn->dropOldestFrames( config->egressMaxFrames, config->egressMaxBytes );
+                break;
+
+            case EgressDisconnect:
+                ++egressDisconnects;
+                conn->dropConnection();
+                break;
 
-            }
         }
     }
 
+    // Schedule only once
+    if (!conn->egressScheduled) {
+        conn->egressScheduled = true;
+        egressPending.push_back( conn );
+    }
+}
+
+/**
+ * Return how many times the egress policy fired
+ */
+EgressStats Webserver::getEgressStats() const
+{
+    EgressStats stats;
+    stats.droppedFrames = egressDropped.load();
+    stats.conflatedFrames = egressConflated.load();
+    stats.disconnects = egressDisconnects.load();
+    return stats;
+}
+
+/**
+ * Send the egress queues of the scheduled connections
+ */
+void Webserver::sendEgress() 
+{
+    // Only the connections with something to send are visited
+    vector< WebserverConnection* > pending;
+    pending.swap( egressPending );
+    for (auto it = pending.begin(); it != pending.end(); ++it)
+        (*it)->sendEgress( config->egressSocketBuffer );
 }
 
 /**
@@ -327,10 +676,59 @@ void Webserver::start()
 {
 
 	// Infinite loop :P
-	for (;;) {
+	running = true;
+	stopping = false;
+	runLoop();
+
+}
+
+/**
+ * Poll the server until ``stop`` is called
+ */
+void Webserver::runLoop() 
+{
+
+	// Loop until stopped
+	while (running) {
 		poll();
 	}
 
+	// Flush everything still pending before returning
+	poll( 0 );
+
+}
+
+/**
+ * Stop the loop started with ``start``
+ */
+void Webserver::stop() 
+{
+
+	// Let the loop exit and interrupt the current poll,
+	// which sends everything that is still held back
+	running = false;
+	stopping = true;
+	wakeup();
+
+}
+
+/**
+ * Check if the caller runs in the thread that polls the server
+ */
+bool Webserver::isPollThread() const
+{
+    return pollThread.load( memory_order_relaxed ) == this_thread::get_id();
+}
+
+/**
+ * Interrupt a poll() that waits for events
+ */
+void Webserver::wakeup() 
+{
+    // Only the first request until the next poll() needs to reach
+    // the server's control socket, the rest are no-ops.
+    if (!wakeupPending.exchange( true ))
+        transport->wakeup();
 }
 
 /**
@@ -338,6 +736,6 @@ void Webserver::start()
  */
 bool Webserver::hasLiveConnections() 
 {
-    unique_lock<mutex> objectLock(connMutex, std::try_to_lock);
+    lock_guard<mutex> objectLock(connMutex);
     return !connections.empty();
 }
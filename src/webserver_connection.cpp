@@ -19,15 +19,22 @@
  */
 
 #include "marblebar/server/webserver_connection.hpp"
+#include "marblebar/server/webserver.hpp"
 #include <sstream>
 
 using namespace mb;
 
+/**
+ * The egress barrier when no structural frame was queued
+ */
+#define NO_BARRIER          (~0ULL)
+
 /**
  * Webserver connection constructor
  */
 WebserverConnection::WebserverConnection( const string& domain, const string uri ) :
-    isIterated(false), domain(domain), uri(uri), egress(), connected(true)
+    server(NULL), socket(NULL), connIndex(0), egressScheduled(false), conflate(false), conflatedValues(0), domain(domain), uri(uri), 
+    ingress(), egress(), egressBytes(0), egressHead(0), egressBarrier(NO_BARRIER), egressIndexed(0), egressIndex(), connected(true), binary(false)
 {
 
 }
@@ -38,6 +45,13 @@ WebserverConnection::WebserverConnection( const string& domain, const string uri
 void WebserverConnection::handleRawData( const char * buf, const size_t len ) 
 {
 
+    // Property events are by far the most frequent frames, so
+    // the usual shape of them is parsed without building the JSON
+    if (IngressParser::parsePropertyEvent( buf, len, ingress )) {
+        handlePropertyEvent( ingress );
+        return;
+    }
+
     // Parse the incoming buffer as JSON
     Json::Value root;
     Json::Reader reader;
@@ -86,16 +100,49 @@ void WebserverConnection::handleRawData( const char * buf, const size_t len )
 /**
  * Return the next available egress packet
  */
-string WebserverConnection::getEgressRawData() 
+EgressFramePtr WebserverConnection::getEgressFrame() 
 {
-    // Return empty string if the queue is empty
+    // Return empty pointer if the queue is empty
     if (egress.empty())
-        return "";
+        return EgressFramePtr();
+
+    // Pop first element, encoding the property values
+    EgressEntry entry = popEgressEntry();
+    if (entry.frame)
+        return entry.frame;
+    return encodeValues( entry.view, entry.values );
+}
+
+/**
+ * Remove the first entry of the egress queue
+ */
+EgressEntry WebserverConnection::popEgressEntry() 
+{
+    EgressEntry entry = std::move( egress.front() );
+    egress.pop_front();
+    ++egressHead;
+    egressBytes -= entry.bytes;
 
-    // Pop first element
-    string ans = egress.front();
-    egress.pop();
-    return ans;
+    // Forget the property values it carries, unless a newer
+    // entry took over the slot
+    if (!egressIndex.empty()) {
+        unsigned int view = entry.frame ? entry.frame->view : entry.view;
+        const PropertyValues & values = entry.frame ? entry.frame->values : entry.values;
+        for (size_t i=0; i<values.size(); ++i) {
+            auto slot = egressIndex.find( ((unsigned long long)view << 32) | values[i].first );
+            if ((slot != egressIndex.end()) && (slot->second.entry == egressHead - 1))
+                egressIndex.erase( slot );
+        }
+    }
+    return entry;
+}
+
+/**
+ * Check if there are frames waiting in the egress queue
+ */
+bool WebserverConnection::hasEgressFrames() 
+{
+    return !egress.empty();
 }
 
 /**
@@ -103,8 +150,183 @@ string WebserverConnection::getEgressRawData()
  */
 void WebserverConnection::sendRawData( const string& data ) 
 {
-    // Add data to the egress queue
-    egress.push(data);
+    // Wrap data in a frame
+    sendFrame( make_shared<EgressFrame>( data ) );
+}
+
+/**
+ * Send an already encoded frame
+ */
+void WebserverConnection::sendFrame( const EgressFramePtr& frame ) 
+{
+    // Nothing goes out after a disconnect request
+    if (!connected)
+        return;
+
+    // When the connection is backlogged, property values
+    // replace the ones that are still queued
+    if (conflate && !frame->values.empty() && !egress.empty()) {
+        queueValues(frame);
+
+    } else {
+        // Values queued before a structural frame must not
+        // be changed any more
+        if (frame->values.empty())
+            egressBarrier = egressHead + egress.size();
+
+        // Add frame to the egress queue
+        EgressEntry entry;
+        entry.frame = frame;
+        entry.view = 0;
+        entry.bytes = frame->data.length();
+        egress.push_back(entry);
+        egressBytes += entry.bytes;
+    }
+
+    // Let the server know we have something to send
+    if (server)
+        server->scheduleEgress(this);
+}
+
+/**
+ * Add the values of the shared frames still queued in the index
+ */
+void WebserverConnection::indexQueuedFrames() 
+{
+    // Frames queued while the connection was not backlogged are sent
+    // as they are, and indexed only if they wait long enough
+    if (egressIndexed < egressHead)
+        egressIndexed = egressHead;
+    for (; egressIndexed < egressHead + egress.size(); ++egressIndexed) {
+        const EgressFramePtr & frame = egress[ egressIndexed - egressHead ].frame;
+        if (!frame) continue;
+        for (size_t i=0; i<frame->values.size(); ++i) {
+            EgressSlot slot;
+            slot.entry = egressIndexed;
+            slot.index = i;
+            egressIndex[ ((unsigned long long)frame->view << 32) | frame->values[i].first ] = slot;
+        }
+    }
+}
+
+/**
+ * Queue the values of a frame, replacing the queued values of the same properties
+ */
+void WebserverConnection::queueValues( const EgressFramePtr& frame ) 
+{
+    // Estimate the encoded size of every value
+    size_t valueBytes = frame->data.length() / (frame->values.size() > 0 ? frame->values.size() : 1);
+
+    // The values of the frames queued before can be replaced too
+    indexQueuedFrames();
+
+    for (size_t i=0; i<frame->values.size(); ++i) {
+        const pair< unsigned int, Json::Value > & value = frame->values[i];
+        unsigned long long key = ((unsigned long long)frame->view << 32) | value.first;
+
+        // Replace a queued value in place, if no structural
+        // frame was queued after it
+        auto slot = egressIndex.find(key);
+        if ((slot != egressIndex.end()) && ((egressBarrier == NO_BARRIER) || (slot->second.entry > egressBarrier))) {
+            EgressEntry & entry = egress[ slot->second.entry - egressHead ];
+
+            // A shared frame is turned into values of our own
+            if (entry.frame) {
+                entry.view = entry.frame->view;
+                entry.values = entry.frame->values;
+                entry.frame.reset();
+            }
+            entry.values[ slot->second.index ].second = value.second;
+            ++conflatedValues;
+            continue;
+        }
+
+        // Merge with the values of the same view at the end of
+        // the queue, or start a new entry
+        if (egress.empty() || egress.back().frame || (egress.back().view != frame->view)) {
+            EgressEntry entry;
+            entry.view = frame->view;
+            entry.bytes = 0;
+            egress.push_back(entry);
+        }
+        EgressEntry & tail = egress.back();
+        EgressSlot newSlot;
+        newSlot.entry = egressHead + egress.size() - 1;
+        newSlot.index = tail.values.size();
+        tail.values.push_back( value );
+        tail.bytes += valueBytes;
+        egressBytes += valueBytes;
+        egressIndex[key] = newSlot;
+    }
+}
+
+/**
+ * Request to disconnect from the socket
+ */
+void WebserverConnection::disconnect() 
+{
+    connected = false;
+    if (server)
+        server->scheduleEgress(this);
+}
+
+/**
+ * Write the egress queue to the socket
+ */
+void WebserverConnection::sendEgress( size_t socketBuffer ) 
+{
+    egressScheduled = false;
+    if (socket == NULL)
+        return;
+
+    // Send the frames of the egress queue, keeping the rest
+    // until the socket drains
+    EgressFramePtr frame;
+    while ( (socket->getPendingBytes() < socketBuffer) && (frame = getEgressFrame()) ) {
+        if (binary && !frame->binary.empty()) {
+            socket->sendFrame(0x02, frame->binary.c_str(), frame->binary.length());
+        } else {
+            socket->sendFrame(0x01, frame->data.c_str(), frame->data.length());
+        }
+    }
+
+    // If we are disconnected, close the socket when everything is sent
+    if (!connected && egress.empty())
+        socket->close();
+}
+
+/**
+ * Check if the egress queue holds more than the given limits
+ */
+bool WebserverConnection::isEgressFull( size_t maxFrames, size_t maxBytes ) 
+{
+    return (egress.size() > maxFrames) || (egressBytes > maxBytes);
+}
+
+/**
+ * Drop the oldest frames until the egress queue fits in the limits
+ */
+size_t WebserverConnection::dropOldestFrames( size_t maxFrames, size_t maxBytes ) 
+{
+    // Always keep the newest frame
+    size_t dropped = 0;
+    while ((egress.size() > 1) && isEgressFull(maxFrames, maxBytes)) {
+        popEgressEntry();
+        ++dropped;
+    }
+    return dropped;
+}
+
+/**
+ * Drop everything in the egress queue and disconnect
+ */
+void WebserverConnection::dropConnection() 
+{
+    egressHead += egress.size();
+    egress.clear();
+    egressIndex.clear();
+    egressBytes = 0;
+    disconnect();
 }
 
 /**
@@ -147,8 +369,25 @@ void WebserverConnection::reply( const string& id, const Json::Value& data )
  */
 void WebserverConnection::sendAction( const string& event, const Json::Value& data, const string& id ) 
 {
-
     // Build and send an action response
+    sendFrame( buildAction( event, data, id ) );
+}
+
+/**
+ * Encode a json-formatted action to a shareable frame
+ */
+EgressFramePtr WebserverConnection::buildAction( const string& event, const Json::Value& data, const string& id ) 
+{
+    return make_shared<EgressFrame>( encodeAction( event, data, id ) );
+}
+
+/**
+ * Encode a json-formatted action to a string
+ */
+string WebserverConnection::encodeAction( const string& event, const Json::Value& data, const string& id ) 
+{
+
+    // Build an action response
     Json::FastWriter writer;
     Json::Value root;
 
@@ -159,8 +398,7 @@ void WebserverConnection::sendAction( const string& event, const Json::Value& da
     root["data"] = data;
 
     // Compile JSON response
-    string jsonResponse = writer.write(root);
-    sendRawData( jsonResponse );
+    return writer.write(root);
 }
 
 /**
@@ -168,7 +406,7 @@ void WebserverConnection::sendAction( const string& event, const Json::Value& da
  */
 bool WebserverConnection::isConnected()
 {
-    return true;
+    return connected;
 }
 
 /**
@@ -0,0 +1,61 @@
+#include <marblebar.hpp>
+#include <iostream>
+#include <chrono>
+
+using namespace mb;
+using namespace std;
+
+/**
+ * Check that coalesced ``update`` events are held across manual
+ * poll() calls, and handled only once their window passes
+ */
+int main(int argc, char ** argv) {
+
+    ConfigPtr config = defaultConfig();
+    config->webserverPort = 15901;
+    KernelPtr kernel = createKernel( config );
+    ViewPtr view = kernel->createView( "Test" );
+
+    // Count the handled updates of a property that coalesces them
+    PIntPtr prop = view->addProperty( make_shared<PInt>("Value", 0) );
+    prop->meta( "coalesce", 200 );
+    int calls = 0, last = -1;
+    prop->on( "update", [&]( const Json::Value & data ) {
+        ++calls;
+        last = data["value"].asInt();
+    });
+
+    // Ten updates 10ms apart, polling by hand like the README loop
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i=0; i<10; ++i) {
+        Json::Value data;
+        data["value"] = i;
+        prop->receiveUIEvent( EventNames::UPDATE, data );
+        kernel->poll( 10 );
+    }
+    if ((calls != 0) && (chrono::steady_clock::now() - start < chrono::milliseconds(200))) {
+        cerr << "updates handled before the window passed: " << calls << endl;
+        return 1;
+    }
+
+    // Only the last one is handled when the window passes
+    while (chrono::steady_clock::now() - start < chrono::milliseconds(400))
+        kernel->poll( 10 );
+    if ((calls != 1) || (last != 9) || ((int)*prop != 9)) {
+        cerr << "expected 1 update with 9, got " << calls << " with " << last << endl;
+        return 1;
+    }
+
+    // Stopping the kernel handles the held ones right away
+    Json::Value data;
+    data["value"] = 42;
+    prop->receiveUIEvent( EventNames::UPDATE, data );
+    kernel->stop();
+    kernel->poll( 0 );
+    if ((calls != 2) || (last != 42)) {
+        cerr << "held update not handled on stop" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <marblebar.hpp>
+#include <iostream>
+
+using namespace mb;
+using namespace std;
+
+/**
+ * A connection without a socket, that returns the merged values as they are
+ */
+class TestConnection : public WebserverConnection {
+public:
+    TestConnection() : WebserverConnection( "", "" ) { conflate = true; };
+    virtual void handleEvent( const string& id, const string& event, const Json::Value& data ) { };
+    virtual void handlePropertyEvent( const PropertyEvent& event ) { };
+    size_t queued() { return egress.size(); };
+protected:
+    virtual EgressFramePtr encodeValues( unsigned int view, const PropertyValues& values )
+        { return make_shared<EgressFrame>( "", view, values ); };
+};
+
+/**
+ * Build a frame with the value of a single property
+ */
+static EgressFramePtr valueFrame( unsigned int prop, int value )
+{
+    PropertyValues values;
+    values.push_back( make_pair( prop, Json::Value(value) ) );
+    return make_shared<EgressFrame>( "values", 0, values );
+}
+
+/**
+ * Check that a newer value replaces the one queued, until a
+ * structural frame is queued after it
+ */
+int main(int argc, char ** argv) {
+
+    TestConnection conn;
+
+    // The same property updated twice before the first flush
+    conn.sendFrame( valueFrame( 3, 1 ) );
+    conn.sendFrame( valueFrame( 3, 2 ) );
+    if (conn.queued() != 1) {
+        cerr << "expected 1 queued entry, got " << conn.queued() << endl;
+        return 1;
+    }
+    EgressFramePtr frame = conn.getEgressFrame();
+    if ((frame->values.size() != 1) || (frame->values[0].second.asInt() != 2)) {
+        cerr << "expected the second value to replace the first" << endl;
+        return 1;
+    }
+
+    // Values queued before a structural frame are kept as they are
+    conn.sendFrame( valueFrame( 3, 3 ) );
+    conn.sendFrame( make_shared<EgressFrame>( "structure" ) );
+    conn.sendFrame( valueFrame( 3, 4 ) );
+    conn.sendFrame( valueFrame( 3, 5 ) );
+    if (conn.queued() != 3) {
+        cerr << "expected 3 queued entries, got " << conn.queued() << endl;
+        return 1;
+    }
+    if (conn.getEgressFrame()->values[0].second.asInt() != 3) {
+        cerr << "value before the structural frame was replaced" << endl;
+        return 1;
+    }
+    conn.getEgressFrame();
+    if (conn.getEgressFrame()->values[0].second.asInt() != 5) {
+        cerr << "value after the structural frame was not replaced" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <marblebar.hpp>
+#include <iostream>
+
+using namespace mb;
+using namespace std;
+
+/**
+ * Check that an ``update`` event held for coalescing is dropped
+ * if the property is removed from it's view before it's handled
+ */
+int main(int argc, char ** argv) {
+
+    ConfigPtr config = defaultConfig();
+    config->webserverPort = 15903;
+    KernelPtr kernel = createKernel( config );
+    ViewPtr view = kernel->createView( "Test" );
+
+    PIntPtr prop = view->addProperty( make_shared<PInt>("Value", 0) );
+    prop->meta( "coalesce", 200 );
+    int calls = 0;
+    prop->on( "update", [&]( const Json::Value & data ) {
+        ++calls;
+    });
+
+    // Hold an update, then remove the property before the window passes
+    Json::Value data;
+    data["value"] = 7;
+    prop->receiveUIEvent( EventNames::UPDATE, data );
+    kernel->poll( 0 );
+    view->removeProperty( prop );
+    if (prop->isAttached()) {
+        cerr << "property still attached after removal" << endl;
+        return 1;
+    }
+
+    // Stopping the kernel flushes everything held, but not this one
+    kernel->stop();
+    kernel->poll( 0 );
+    if ((calls != 0) || ((int)*prop != 0)) {
+        cerr << "update of a removed property was handled" << endl;
+        return 1;
+    }
+
+    return 0;
+}